@@ -3,21 +3,32 @@
 #include <type_traits>
 #include <iostream>
 #include <string>
+#include <cstdlib>
+#include <new>
+#include <deque>
+#include <vector>
+#include <iterator>
+#include <stdexcept>
+#include <algorithm>
+#include <random>
+#include <chrono>
+#include "../SmartPointers/CompressedPair.h"
+
 template <class T, class Del = std::default_delete<T>>
 class UniquePtr {
 public:
 	// Constructors
-	UniquePtr() noexcept : ptr_(nullptr), deleter_(Del()) {}
-	UniquePtr(nullptr_t) noexcept : ptr_(nullptr), deleter_(Del()) {}
-	explicit UniquePtr(T* ptr) noexcept : ptr_(ptr), deleter_(Del()) {}
-	UniquePtr(T* ptr, const Del& deleter) noexcept : ptr_(ptr), deleter_(deleter) {}
-	UniquePtr(T* ptr, Del&& deleter) noexcept : ptr_(ptr), deleter_(std::move(deleter)) {}
-	UniquePtr(UniquePtr&& other) noexcept : ptr_(other.release()), deleter_(std::move(other.deleter_)) {}
+	UniquePtr() noexcept : pair_(nullptr, Del()) {}
+	UniquePtr(nullptr_t) noexcept : pair_(nullptr, Del()) {}
+	explicit UniquePtr(T* ptr) noexcept : pair_(ptr, Del()) {}
+	UniquePtr(T* ptr, const Del& deleter) noexcept : pair_(ptr, deleter) {}
+	UniquePtr(T* ptr, Del&& deleter) noexcept : pair_(ptr, std::move(deleter)) {}
+	UniquePtr(UniquePtr&& other) noexcept : pair_(other.release(), std::move(other.pair_.second())) {}
 
 	// Move assignment operator
 	UniquePtr& operator=(UniquePtr&& other) noexcept {
 		reset(other.release());
-		deleter_ = std::move(other.deleter_);
+		pair_.second() = std::move(other.pair_.second());
 		return *this;
 	}
 
@@ -32,60 +43,59 @@ public:
 
 	// Release ownership
 	T* release() noexcept {
-		T* ptr = ptr_;
-		ptr_ = nullptr;
+		T* ptr = pair_.first;
+		pair_.first = nullptr;
 		return ptr;
 	}
 
 	// Reset pointer and deleter
 	void reset(T* ptr = nullptr) noexcept {
-		if (ptr_ != ptr) {
-			deleter_(ptr_);
-			ptr_ = ptr;
+		if (pair_.first != ptr) {
+			pair_.second()(pair_.first);
+			pair_.first = ptr;
 		}
 	}
 
 	// Swap pointers and deleters
 	void swap(UniquePtr& other) noexcept {
-		std::swap(ptr_, other.ptr_);
-		std::swap(deleter_, other.deleter_);
+		std::swap(pair_.first, other.pair_.first);
+		std::swap(pair_.second(), other.pair_.second());
 	}
 
 	// Accessor
 	T* get() const noexcept {
-		return ptr_;
+		return pair_.first;
 	}
 
 	Del& get_deleter() {
-		return deleter_;
+		return pair_.second();
 	}
 
 	const Del& get_deleter() const {
-		return deleter_;
+		return pair_.second();
 	}
 
 	// Dereference operator
 	T& operator*() const noexcept {
-		return *ptr_;
+		return *pair_.first;
 	}
 
 	T* operator->() const noexcept {
-		return ptr_;
+		return pair_.first;
 	}
 
 	friend std::ostream& operator<<(std::ostream& os, const UniquePtr<T>& p) {
-		os << p.ptr_;
+		os << p.pair_.first;
 		return os;
 	}
 
 	// Boolean conversion operator
 	explicit operator bool() const noexcept {
-		return ptr_ != nullptr;
+		return pair_.first != nullptr;
 	}
 
 private:
-	T* ptr_;
-	Del deleter_;
+	CompressedPair<Del, T*> pair_;
 };
 
 template <class T, class D>
@@ -96,25 +106,25 @@ public:
 	using deleter_type = D;
 
 	// Constructors
-	constexpr UniquePtr() noexcept : ptr_(nullptr), deleter_(deleter_type()) {}
+	constexpr UniquePtr() noexcept : pair_(nullptr, deleter_type()) {}
 
 	template <class U>
-	explicit UniquePtr(U p) noexcept : ptr_(p), deleter_(deleter_type()) {}
+	explicit UniquePtr(U p) noexcept : pair_(p, deleter_type()) {}
 
 	template <class U>
 	UniquePtr(U p, typename std::enable_if<std::is_convertible<U, pointer>::value, deleter_type>::type d) noexcept
-		: ptr_(p), deleter_(d) {}
+		: pair_(p, d) {}
 
 	template <class U>
 	UniquePtr(U p, typename std::enable_if<std::is_convertible<U, pointer>::value, deleter_type&&>::type d) noexcept
-		: ptr_(p), deleter_(std::move(d)) {}
+		: pair_(p, std::move(d)) {}
 
-	UniquePtr(UniquePtr&& u) noexcept : ptr_(u.ptr_), deleter_(std::move(u.deleter_)) {
-		u.ptr_ = nullptr;
+	UniquePtr(UniquePtr&& u) noexcept : pair_(u.pair_.first, std::move(u.pair_.second())) {
+		u.pair_.first = nullptr;
 	}
 
 	template <class U, class E>
-	UniquePtr(UniquePtr<U, E>&& u) noexcept : ptr_(u.release()), deleter_(std::move(u.get_deleter())) {}
+	UniquePtr(UniquePtr<U, E>&& u) noexcept : pair_(u.release(), std::move(u.get_deleter())) {}
 
 	// Destructor
 	~UniquePtr() {
@@ -124,14 +134,14 @@ public:
 	// Move assignment operators
 	UniquePtr& operator=(UniquePtr&& u) noexcept {
 		reset(u.release());
-		deleter_ = std::move(u.deleter_);
+		pair_.second() = std::move(u.pair_.second());
 		return *this;
 	}
 
 	template <class U, class E>
 	UniquePtr& operator=(UniquePtr<U, E>&& u) noexcept {
 		reset(u.release());
-		deleter_ = std::move(u.get_deleter());
+		pair_.second() = std::move(u.get_deleter());
 		return *this;
 	}
 
@@ -142,38 +152,38 @@ public:
 
 	// Element access
 	T& operator[](size_t i) const {
-		return ptr_[i];
+		return pair_.first[i];
 	}
 
 	// Accessors
 	pointer get() const noexcept {
-		return ptr_;
+		return pair_.first;
 	}
 
 	deleter_type& get_deleter() noexcept {
-		return deleter_;
+		return pair_.second();
 	}
 
 	const deleter_type& get_deleter() const noexcept {
-		return deleter_;
+		return pair_.second();
 	}
 
 	explicit operator bool() const noexcept {
-		return ptr_ != nullptr;
+		return pair_.first != nullptr;
 	}
 
 	// Release ownership
 	pointer release() noexcept {
-		pointer p = ptr_;
-		ptr_ = nullptr;
+		pointer p = pair_.first;
+		pair_.first = nullptr;
 		return p;
 	}
 
 	// Reset pointer and deleter
 	void reset(pointer p = pointer()) noexcept {
-		if (ptr_ != p) {
-			deleter_(ptr_);
-			ptr_ = p;
+		if (pair_.first != p) {
+			pair_.second()(pair_.first);
+			pair_.first = p;
 		}
 	}
 
@@ -186,15 +196,17 @@ public:
 
 	// Swap pointers and deleters
 	void swap(UniquePtr& u) noexcept {
-		std::swap(ptr_, u.ptr_);
-		std::swap(deleter_, u.deleter_);
+		std::swap(pair_.first, u.pair_.first);
+		std::swap(pair_.second(), u.pair_.second());
 	}
 
 private:
-	pointer ptr_;
-	deleter_type deleter_;
+	CompressedPair<deleter_type, pointer> pair_;
 };
 
+static_assert(sizeof(UniquePtr<int>) == sizeof(int*), "a stateless deleter must cost no space");
+static_assert(sizeof(UniquePtr<int[]>) == sizeof(int*), "a stateless deleter must cost no space");
+
 // Non-member swap function
 template <class T, class Del>
 void Swap(UniquePtr<T, Del>& lhs, UniquePtr<T, Del>& rhs) noexcept {
@@ -232,27 +244,45 @@ struct free_deleter {
 	void operator()(void* p) const { free(p); }
 };
 
+static_assert(sizeof(UniquePtr<int[], free_deleter>) == sizeof(int*), "free_deleter must cost no space");
+
+
 
 
 
 
 
 
+template<class T>
+class Deque_A;
 
+// Walks the blocks directly: pos is the linear position in the deque and
+// cur the element at it, so stepping only reloads cur at a block boundary
 template<class T>
 class iterator
 {
 private:
-	T* ptr;
-	T* ptr_arr;
-	int pos, j;
+	Deque_A<T>* deque;
+	int pos;
+	T* cur;
+
+	bool block_start() const { return (pos & (Deque_A<T>::K - 1)) == 0; }
 public:
-	iterator() {}
-	iterator(T* pt) : ptr(pt) {}
+	using iterator_category = std::random_access_iterator_tag;
+	using value_type = T;
+	using difference_type = std::ptrdiff_t;
+	using pointer = T*;
+	using reference = T&;
+
+	iterator() : deque(nullptr), pos(0), cur(nullptr) {}
+	iterator(Deque_A<T>* dq, int index) : deque(dq), pos(dq->front_pos + index), cur(dq->slot(pos)) {}
 
 	iterator& operator++()
 	{
-		ptr++;
+		++pos;
+		++cur;
+		if (block_start())
+			cur = deque->slot(pos);
 		return *this;
 	}
 	iterator operator++(int)
@@ -264,7 +294,11 @@ public:
 
 	iterator& operator--()
 	{
-		ptr--;
+		bool reload = block_start();
+		--pos;
+		--cur;
+		if (reload)
+			cur = deque->slot(pos);
 		return *this;
 	}
 	iterator operator--(int)
@@ -274,86 +308,110 @@ public:
 		return tmp;
 	}
 
-	iterator operator+(int n)
+	iterator operator+(difference_type n) const
 	{
-		return iterator(ptr + n);
+		iterator tmp = *this;
+		return tmp += n;
 	}
 
-	iterator operator-(int n)
+	iterator operator-(difference_type n) const
 	{
-		return iterator(ptr - n);
+		iterator tmp = *this;
+		return tmp -= n;
 	}
-	iterator operator+=(int n)
+
+	friend iterator operator+(difference_type n, const iterator& it)
 	{
-		return iterator(ptr += n);
+		return it + n;
 	}
 
-	iterator operator-=(int n)
+	difference_type operator-(const iterator& other) const
 	{
-		return iterator(ptr -= n);
+		return pos - other.pos;
 	}
-	T& operator*()
+
+	iterator& operator+=(difference_type n)
+	{
+		pos += (int)n;
+		cur = deque->slot(pos);
+		return *this;
+	}
+
+	iterator& operator-=(difference_type n)
 	{
-		return *ptr;
+		return *this += -n;
 	}
-	iterator begin();
-	iterator end();
+
+	T& operator*() const
+	{
+		return *cur;
+	}
+
+	T* operator->() const
+	{
+		return cur;
+	}
+
+	T& operator[](difference_type n) const
+	{
+		return *(*this + n);
+	}
+
+	bool operator==(const iterator& other) const { return pos == other.pos; }
+	bool operator!=(const iterator& other) const { return pos != other.pos; }
+	bool operator<(const iterator& other) const { return pos < other.pos; }
+	bool operator>(const iterator& other) const { return pos > other.pos; }
+	bool operator<=(const iterator& other) const { return pos <= other.pos; }
+	bool operator>=(const iterator& other) const { return pos >= other.pos; }
 };
 
 
 
 template<class T>
-class Deque_A : public iterator<T>
+class Deque_A
 {
 public:
 	//private:
 
-	UniquePtr<UniquePtr<T[]>[]> arr;
+	// Elements per block, a power of two so that (block, offset)
+	// of an index is a shift and a mask
+	static constexpr int K = 16;
+
+	// Blocks are raw storage; only slots in [front_pos, rear_pos] hold
+	// constructed elements
+	using block = UniquePtr<T[], free_deleter>;
 
-	UniquePtr<T[]> head;
-	UniquePtr<T[]> tail;
-	UniquePtr<T[]>ptr_get;
+	UniquePtr<block[]> arr;
 
+	// Linear position (block * K + offset) of the first and last element
 	int front_pos, rear_pos;
 	int size;
-	int capacity = 3;
 	int blocks;
-	int K = capacity;
-	int cols;
-	int consider_block;
-	int front_cols;
-	int get_from_front;
-	bool flag = false;
+	int capacity;
 
 	Deque_A()
 	{
-		get_from_front = 1;
-		consider_block = 0;
-		cols = 0;
+		blocks = 1;
 
-		front_cols = K - 1;
-
-		blocks = capacity / 3;
+		capacity = blocks * K;
 
-		front_pos = -1;
+		front_pos = K / 2;
 
-		rear_pos = -1;
+		rear_pos = front_pos - 1;
 
 		size = 0;
 
-		head = MakeUnique<T[]>(1);
-
-		tail = MakeUnique<T[]>(1);
-
-		arr = MakeUnique<UniquePtr<T[]>[]>(blocks);
-
-		UniquePtr<T[]> A;
+		arr = MakeUnique<block[]>(blocks);
 
+		arr[0] = new_block();
+	}
 
-		for (int i = 0; i < blocks; ++i)
+	~Deque_A()
+	{
+		if constexpr (!std::is_trivially_destructible_v<T>)
 		{
-			A = MakeUnique<T[]>(capacity);
-			arr[i] = std::move(A);
+			for (int i = 0; i < size; ++i)
+				(*this)[i].~T();
 		}
 	}
 public:
@@ -361,19 +419,37 @@ public:
 	int size_();
 	bool empty();
 	void push_back(const T& data);
+	void push_back(T&& data);
+	template <class ...Args>
+	T& emplace_back(Args&& ...args);
+	template <class ...Args>
+	T& emplace_front(Args&& ...args);
 	T get_front();
 	T get_back();
+
 	T& operator[](int index)
 	{
-		return ptr_get[index];
+		unsigned pos = front_pos + index;
+		return arr[pos / K][pos % K];
+	}
+
+	T& at(int index)
+	{
+		if (index < 0 || index >= size)
+			throw std::out_of_range("Deque_A::at");
+		return (*this)[index];
 	}
+
 	void push_front(const T& data);
+	void push_front(T&& data);
 
 	void allocate()
 	{
 		std::cout << "pass" << '\n';
 	}
 
+	// Popping an empty deque is a caller bug: both ends report it and
+	// abort, like get_front and get_back
 	void pop_back();
 
 	void pop_front();
@@ -381,196 +457,96 @@ public:
 
 	iterator<T> begin()
 	{
-		output();
-		return iterator<T>(&ptr_get[0]);
+		return iterator<T>(this, 0);
 	}
 
 	iterator<T> end()
 	{
-		output();
-		return iterator<T>(&ptr_get[size - 1]);
+		return iterator<T>(this, size);
 	}
 
-	void output()
-	{
-		UniquePtr<T[]>ptr = MakeUnique<T[]>(capacity);
-		int counter = 0;
-		for (int i = 0; i < blocks; ++i)
-		{
-			for (int g = 0; g < K; ++g)
-			{
-				ptr[counter] = arr[i][g];
+	void resize(int value);
 
-				++counter;
+private:
+	friend class iterator<T>;
 
-			}
-		}
-
-		ptr_get = MakeUnique<T[]>(size);
-		counter = 0;
-		std::string str;
-		for (int g = 0; g < capacity; ++g)
-		{
-			if (ptr[g] == head[0])
-			{
-				for (int k = g; k < capacity; ++k)
-				{
-					if (counter == size) break;
-					ptr_get[counter] = ptr[k];
-					str += ptr_get[counter] + " ";
-					++counter;
-				}
-				break;
-			}
-		}
+	void reallocate_map(int new_blocks);
+	void make_room();
 
+	// Element storage at linear position pos; null outside the block map,
+	// which only the end and before-begin iterators point at
+	T* slot(int pos)
+	{
+		if (pos < 0 || pos >= capacity)
+			return nullptr;
+		return arr[pos / K].get() + pos % K;
 	}
 
-	void resize(int value);
-
+	static block new_block()
+	{
+		return block(static_cast<T*>(malloc(sizeof(T) * K)));
+	}
 };
 
+// Rebuilds the block map with new_blocks entries and centers the blocks
+// that hold elements in it. Blocks are moved, never the elements themselves.
 template <class T>
-void Deque_A<T>::resize(int value)
+void Deque_A<T>::reallocate_map(int new_blocks)
 {
-	if (value > size)
-	{
-		while (true) {
-			if (value % K != 0)
-			{
-				value++;
-			}
-			else break;
-		}
-
-		int new_blocks = (value - (blocks*K)) / K;
-
-
-
+	int first_used = front_pos / K;
+	int used = size == 0 ? 0 : rear_pos / K - first_used + 1;
+	int first_block = (new_blocks - used) / 2;
 
-		int get_old_block = blocks;
-		blocks += new_blocks;
-		capacity = blocks * K;
-
-		int counter = 0;
-		UniquePtr<T[]> get_elems = MakeUnique<T[]>(get_old_block*capacity);
-		for (int i = 0; i < get_old_block; ++i)
-		{
-			for (int g = 0; g < K; ++g)
-			{
-				get_elems[counter] = arr[i][g];
-
-				++counter;
-			}
-		}
-		arr.reset();
-		counter = 0;
-
-		arr = MakeUnique<UniquePtr<T[]>[]>(blocks);
+	UniquePtr<block[]> map = MakeUnique<block[]>(new_blocks);
 
-		UniquePtr<T[]> A;
-
-		for (int i = 0; i < blocks; ++i)
-		{
-			A = MakeUnique < T[] >(K);
-
-			arr[i] = std::move(A);
-		}
-
-
-
-		for (int i = 0; i < blocks; ++i)
-		{
-			for (int g = 0; g < K; ++g)
-			{
-				arr[i][g] = get_elems[counter];
-				++counter;
-			}
-		}
-		get_elems.reset();
-
-	}
-	else if (value < size)
+	for (int i = 0; i < used; ++i)
 	{
+		map[first_block + i] = std::move(arr[first_used + i]);
+	}
 
-		while (true) {
-			if (value % K != 0)
-			{
-				value--;
-			}
-			else break;
-		}
-
-
-		blocks = (blocks*K - (capacity - value)) / K;
-		int counter = 0;
-		capacity = blocks * K;
-		UniquePtr<T[]> get_elems = MakeUnique<T[]>(blocks*capacity);
-		for (int i = 0; i < blocks; ++i)
-		{
-			for (int g = 0; g < K; ++g)
-			{
-				get_elems[counter] = arr[i][g];
-
-				++counter;
-			}
-		}
-		arr.reset();
-		counter = 0;
-
-		arr = MakeUnique<UniquePtr<T[]>[]>(blocks);
-
-		UniquePtr<T[]> A;
-
-		for (int i = 0; i < blocks; ++i)
-		{
-			A = MakeUnique < T[] >(K);
-
-			arr[i] = std::move(A);
-		}
-
-
-
-		for (int i = 0; i < blocks; ++i)
-		{
-			for (int g = 0; g < K; ++g)
-			{
-				arr[i][g] = get_elems[counter];
-				++counter;
-			}
-		}
-		get_elems.reset();
+	// Spare blocks of the old map are reused before allocating new ones
+	int spare = 0;
+	for (int i = 0; i < new_blocks; ++i)
+	{
+		if (map[i]) continue;
 
+		while (spare < blocks && !arr[spare]) ++spare;
 
-		UniquePtr<T[]>ptr = MakeUnique<T[]>(capacity);
-		counter = 0;
-		for (int i = 0; i < blocks; ++i)
-		{
-			for (int g = 0; g < K; ++g)
-			{
-				ptr[counter] = arr[i][g];
+		if (spare < blocks)
+			map[i] = std::move(arr[spare]);
+		else
+			map[i] = new_block();
+	}
 
-				++counter;
+	arr = std::move(map);
+	blocks = new_blocks;
+	capacity = blocks * K;
 
-			}
-		}
+	front_pos = size == 0 ? capacity / 2 : first_block * K + front_pos % K;
+	rear_pos = front_pos + size - 1;
+}
 
-		ptr_get = MakeUnique<T[]>(size);
-		counter = 0;
+// Called when one end runs out of blocks. Recenters in place while the map
+// is mostly spare, otherwise doubles it, so pushes stay amortized O(1).
+template <class T>
+void Deque_A<T>::make_room()
+{
+	int used = size == 0 ? 0 : rear_pos / K - front_pos / K + 1;
 
-		for (int g = 0; g < capacity; ++g)
-		{
-			if (ptr[g] == head[0])
-			{
+	reallocate_map(2 * (used + 2) > blocks ? 2 * blocks + 2 : blocks);
+}
 
-				size = capacity - g;
-				break;
-			}
-		}
-		
-	}
+template <class T>
+void Deque_A<T>::resize(int value)
+{
+	int new_blocks = (value + K - 1) / K;
+	int used = size == 0 ? 0 : rear_pos / K - front_pos / K + 1;
 
+	if (new_blocks < used) new_blocks = used;
+	if (new_blocks < 1) new_blocks = 1;
 
+	if (new_blocks != blocks)
+		reallocate_map(new_blocks);
 }
 
 
@@ -579,31 +555,20 @@ void Deque_A<T>::resize(int value)
 template<class T>
 void Deque_A<T>::pop_back()
 {
-
-
 	if (size == 0) {
-		std::cout << "Deque undekhkhrflow" << std::endl;
-		return;
-	}
-
-	if (front_pos == rear_pos && blocks == 1) {
-		front_pos = rear_pos = -1;
-		size--;
-		return;
+		std::cout << "Deque underflow" << std::endl;
+		abort();
 	}
 
+	arr[rear_pos / K][rear_pos % K].~T();
+	rear_pos--;
+	size--;
 
-	rear_pos = (rear_pos - 1 + capacity) % capacity;
-	if (cols == 1)
+	if (size == 0)
 	{
-		cols = K;
-		size--;
-		return;
+		front_pos = capacity / 2;
+		rear_pos = front_pos - 1;
 	}
-	cols--;
-	size--;
-	return;
-
 }
 
 template<class T>
@@ -621,215 +586,60 @@ int Deque_A<T>::size_()
 template <class X>
 bool Deque_A<X>::empty()
 {
-	if (front_pos == -1 && rear_pos == -1)
-		return true;
-	else
-		return false;
+	return size == 0;
 }
+// Growth only moves block pointers, so references into the deque stay
+// valid and the argument may alias an element
 template <class T>
-void Deque_A<T>::push_back(const T& data)
+template <class ...Args>
+T& Deque_A<T>::emplace_back(Args&& ...args)
 {
+	if (rear_pos + 1 == capacity)
+		make_room();
+
+	int pos = rear_pos + 1;
+	T* slot = new (&arr[pos / K][pos % K]) T(std::forward<Args>(args)...);
+	rear_pos = pos;
+	size++;
+	return *slot;
+}
 
+template <class T>
+template <class ...Args>
+T& Deque_A<T>::emplace_front(Args&& ...args)
+{
+	if (front_pos == 0)
+		make_room();
+
+	int pos = front_pos - 1;
+	T* slot = new (&arr[pos / K][pos % K]) T(std::forward<Args>(args)...);
+	front_pos = pos;
+	size++;
+	return *slot;
+}
 
-	if (size == 0)
-	{
-
-		arr[0][cols++] = data;
-
-		head[0] = arr[0][0];
-
-		tail[0] = arr[0][0];
-		front_pos = rear_pos = 0;
-		front_cols = -1;
-		size++;
-	}
-	else
-	{
-		if (size == capacity || rear_pos / K == blocks - 1 && cols == 3)
-		{
-
-			cols = 0;
-			int counter = 0;
-			UniquePtr<T[]> get_elems = MakeUnique<T[]>(blocks*capacity);
-			for (int i = 0; i < blocks; ++i)
-			{
-				for (int g = 0; g < K; ++g)
-				{
-					get_elems[counter] = arr[i][g];
-
-					++counter;
-				}
-			}
-			arr.reset();
-			counter = 0;
-
-
-			capacity += 3;
-			blocks += 1;
-
-			arr = MakeUnique<UniquePtr<T[]>[]>(blocks);
-
-			UniquePtr<T[]> A;
-
-			for (int i = 0; i < blocks; ++i)
-			{
-				A = MakeUnique < T[] >(K);
-				arr[i] = std::move(A);
-			}
-
-			for (int i = 0; i < blocks; ++i)
-			{
-				for (int g = 0; g < K; ++g)
-				{
-					arr[i][g] = get_elems[counter];
-
-					++counter;
-				}
-			}
-
-
-			get_elems.reset();
-			arr[blocks - 1][cols++] = data;
-			tail[0] = arr[blocks - 1][cols - 1];
-			rear_pos++;
-
-			size++;
-
-		}
-		else {
-			if (cols == K)
-			{
-
-				cols = 0;
-				rear_pos++;
-				arr[rear_pos / K][0] = data;
-				tail[0] = arr[rear_pos / K][0];
-				size++;
-				cols++;
-				return;
-			}
-
-			arr[rear_pos / K][cols++] = data;
-			tail[0] = arr[rear_pos / K][cols - 1];
-
-
-			rear_pos++;
-			size++;
-
-
-
-		}
-	}
-
-	for (int i = 0; i < blocks; ++i)
-	{
-		for (int g = 0; g < K; ++g)
-		{
-			std::cout << arr[i][g] << " ";
-		}
-	}
-	std::cout << std::endl;
+template <class T>
+void Deque_A<T>::push_back(const T& data)
+{
+	emplace_back(data);
+}
 
+template <class T>
+void Deque_A<T>::push_back(T&& data)
+{
+	emplace_back(std::move(data));
 }
 
 template <class T>
 void Deque_A<T>::push_front(const T& data)
 {
-	if (size == 0)
-	{
-		arr[0][0] = data;
-
-		head[0] = arr[0][0];
-
-		tail[0] = arr[0][0];
-		front_pos = rear_pos = get_from_front = 0;
-
-		size++;
-	}
-	else
-	{
-		if (front_pos == 0)
-		{
-
-			int counter = 0;
-			UniquePtr<T[]> get_elems = MakeUnique<T[]>(blocks*capacity);
-			for (int i = 0; i < blocks; ++i)
-			{
-				for (int g = 0; g < K; ++g)
-				{
-					get_elems[counter] = arr[i][g];
-
-					++counter;
-				}
-			}
-
-			arr.reset();
-			counter = 0;
-
-
-
-			capacity += (K * 2);
-
-			int get_prev_blocks = blocks;
-			blocks += 2;
-
-			arr = MakeUnique<UniquePtr<T[]>[]>(blocks);
-
-			UniquePtr<T[]> A;
-
-			for (int i = 0; i < blocks; ++i)
-			{
-				A = MakeUnique < T[] >(K);
-				arr[i] = std::move(A);
-			}
-
-
-			for (int i = 1; i < get_prev_blocks + 1; ++i)
-			{
-				for (int g = 0; g < K; ++g)
-				{
-					arr[i][g] = get_elems[counter];
-					++counter;
-				}
-			}
-
-
-			rear_pos = (size + K - 1);
-
-			front_pos = K - 1;
-			front_cols = K - 1;
-
-			get_from_front = K - 1;
-
-			get_elems.reset();
-			arr[0][front_cols--] = data;
-			head[0] = arr[0][front_cols + 1];
-			size++;
-
-		}
-		else
-		{
-			if (front_cols == -1)
-			{
-				front_cols = K - 1;
-				front_pos--;
-				arr[front_pos / K][front_cols--] = data;
-				head[0] = arr[front_pos / K][front_cols + 1];
-
-				size++;
-				return;
-			}
-
-			arr[front_pos / K][front_cols--] = data;
-			head[0] = arr[front_pos / K][front_cols + 1];
-			front_pos--;
-			get_from_front--;
-			size++;
-		}
-	}
-
-
+	emplace_front(data);
+}
 
+template <class T>
+void Deque_A<T>::push_front(T&& data)
+{
+	emplace_front(std::move(data));
 }
 
 template <class T>
@@ -840,9 +650,7 @@ T Deque_A<T>::get_front()
 		abort();
 	}
 
-
-
-	return arr[front_pos / K][front_cols + 1];
+	return arr[front_pos / K][front_pos % K];
 }
 
 template <class T>
@@ -852,48 +660,105 @@ T Deque_A<T>::get_back()
 		std::cout << "Deque underflow" << std::endl;
 		abort();
 	}
-	if (flag) rear_pos--;
 
-	return arr[rear_pos / K][cols - 1];
+	return arr[rear_pos / K][rear_pos % K];
 }
 
 
 template <class T>
 void Deque_A<T>::pop_front()
 {
-
-
-
 	if (size == 0) {
-		std::cout << "Deque undbbbberflow" << std::endl;
+		std::cout << "Deque underflow" << std::endl;
 		abort();
 	}
 
+	arr[front_pos / K][front_pos % K].~T();
+	front_pos++;
+	size--;
 
-	if (front_pos == rear_pos && blocks == 1) {
-		front_pos = rear_pos = -1;
-		size--;
-		return;
+	if (size == 0)
+	{
+		front_pos = capacity / 2;
+		rear_pos = front_pos - 1;
 	}
+}
+
 
+template <class F>
+double measure_ms(F&& fn)
+{
+	auto start = std::chrono::steady_clock::now();
+	fn();
+	auto stop = std::chrono::steady_clock::now();
+	return std::chrono::duration<double, std::milli>(stop - start).count();
+}
 
-	front_pos = (front_pos + 1) % capacity;
-	if (front_pos%K == 0)
+void bench_scan_and_index()
+{
+	const int n = 1 << 20;
+
+	Deque_A<int> dq;
+	std::deque<int> sd;
+	for (int i = 0; i < n; ++i)
 	{
-		front_cols = -1;
-		head[0] = arr[front_pos / K][front_cols + 1];
-		size--;
-		return;
+		if (i % 2) { dq.push_back(i); sd.push_back(i); }
+		else { dq.push_front(i); sd.push_front(i); }
 	}
-	front_cols++;
-	size--;
-	head[0] = arr[front_pos / K][front_cols + 1];
-	return;
 
+	std::vector<int> idx(n);
+	std::mt19937 gen(42);
+	std::uniform_int_distribution<int> dist(0, n - 1);
+	for (int& i : idx) i = dist(gen);
 
+	long long sum = 0;
+
+	double scan_a = measure_ms([&] { for (auto it = dq.begin(); it != dq.end(); ++it) sum += *it; });
+	double scan_s = measure_ms([&] { for (auto it = sd.begin(); it != sd.end(); ++it) sum += *it; });
+	double rand_a = measure_ms([&] { for (int i : idx) sum += dq[i]; });
+	double rand_s = measure_ms([&] { for (int i : idx) sum += sd[i]; });
+	double sort_a = measure_ms([&] { std::sort(dq.begin(), dq.end()); });
+
+	std::cout << "elements: " << n << " (checksum " << sum << ")\n";
+	std::cout << "full scan      Deque_A " << scan_a << " ms, std::deque " << scan_s << " ms\n";
+	std::cout << "random index   Deque_A " << rand_a << " ms, std::deque " << rand_s << " ms\n";
+	std::cout << "std::sort      Deque_A " << sort_a << " ms, sorted: "
+		<< std::is_sorted(dq.begin(), dq.end()) << '\n';
 }
 
-int main()
+struct Payload256
+{
+	char bytes[256];
+};
+
+template <class D, class T>
+double fill_ms(int n, const T& value)
+{
+	return measure_ms([&] {
+		D dq;
+		for (int i = 0; i < n; ++i)
+		{
+			T copy = value;
+			if (i % 2) dq.push_back(std::move(copy));
+			else dq.emplace_front(value);
+		}
+	});
+}
+
+void bench_payloads()
 {
+	const int n = 1 << 18;
+	std::string str(48, 'x');
+	Payload256 payload{};
+
+	std::cout << "std::string  Deque_A " << fill_ms<Deque_A<std::string>>(n, str)
+		<< " ms, std::deque " << fill_ms<std::deque<std::string>>(n, str) << " ms\n";
+	std::cout << "256-byte     Deque_A " << fill_ms<Deque_A<Payload256>>(n, payload)
+		<< " ms, std::deque " << fill_ms<std::deque<Payload256>>(n, payload) << " ms\n";
+}
 
+int main()
+{
+	bench_scan_and_index();
+	bench_payloads();
 }
\ No newline at end of file
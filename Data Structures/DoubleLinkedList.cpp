@@ -1,4 +1,11 @@
 ﻿#include <iostream>
+#include <vector>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <list>
+#include <new>
+#include <utility>
 
 template<class T>
 struct Node
@@ -12,52 +19,268 @@ struct Node
 	}
 	Node(T value):next(nullptr),prev(nullptr),data(value){}
 };
+
+// Express lane of the skip index: a tower standing on one list node.
+// width[i] is the number of list positions to next[i], or to the end of
+// the list when next[i] is null.
+template<class T>
+struct SkipNode
+{
+	Node<T>* node;
+	std::vector<SkipNode<T>*> next;
+	std::vector<int> width;
+	SkipNode(Node<T>* node, int levels) :node(node), next(levels, nullptr), width(levels, 0) {}
+};
+
+// Indexable skip list layered over the list nodes. About one node in
+// four gets a tower, so positional lookups descend the towers in
+// O(log n) and finish with a short walk along the list itself.
+template<class T>
+struct SkipIndex
+{
+	static constexpr int maxLevel = 12;
+
+	// Stands before the head, at position -1
+	SkipNode<T> header;
+	uint32_t seed = 2463534242u;
+
+	explicit SkipIndex(int size) :header(nullptr, maxLevel)
+	{
+		for (int i = 0; i < maxLevel; ++i)
+			header.width[i] = size + 1;
+	}
+
+	~SkipIndex()
+	{
+		SkipNode<T>* temp = header.next[0];
+		while (temp)
+		{
+			SkipNode<T>* next = temp->next[0];
+			delete temp;
+			temp = next;
+		}
+	}
+
+	int random_level()
+	{
+		int level = 0;
+		while (level < maxLevel)
+		{
+			seed ^= seed << 13;
+			seed ^= seed >> 17;
+			seed ^= seed << 5;
+			if (seed & 3) break;
+			++level;
+		}
+		return level;
+	}
+
+	// Fills update/updatePos with the last tower before pos on each level
+	void find(int pos, SkipNode<T>** update, int* updatePos)
+	{
+		SkipNode<T>* x = &header;
+		int xp = -1;
+		for (int i = maxLevel - 1; i >= 0; --i)
+		{
+			while (x->next[i] && xp + x->width[i] < pos)
+			{
+				xp += x->width[i];
+				x = x->next[i];
+			}
+			update[i] = x;
+			updatePos[i] = xp;
+		}
+	}
+
+	// Nearest list node at or before pos that has a tower, with its position
+	Node<T>* nearest(int pos, Node<T>* head, int& nodePos)
+	{
+		SkipNode<T>* x = &header;
+		int xp = -1;
+		for (int i = maxLevel - 1; i >= 0; --i)
+			while (x->next[i] && xp + x->width[i] <= pos)
+			{
+				xp += x->width[i];
+				x = x->next[i];
+			}
+		nodePos = xp < 0 ? 0 : xp;
+		return xp < 0 ? head : x->node;
+	}
+
+	// node has just been linked in at pos
+	void inserted(int pos, Node<T>* node)
+	{
+		SkipNode<T>* update[maxLevel];
+		int updatePos[maxLevel];
+		find(pos, update, updatePos);
+
+		int level = random_level();
+		SkipNode<T>* tower = level ? new SkipNode<T>(node, level) : nullptr;
+		for (int i = 0; i < maxLevel; ++i)
+		{
+			if (i < level)
+			{
+				tower->next[i] = update[i]->next[i];
+				tower->width[i] = updatePos[i] + update[i]->width[i] + 1 - pos;
+				update[i]->next[i] = tower;
+				update[i]->width[i] = pos - updatePos[i];
+			}
+			else
+				++update[i]->width[i];
+		}
+	}
+
+	// The list node at pos is about to be unlinked
+	void erased(int pos)
+	{
+		SkipNode<T>* update[maxLevel];
+		int updatePos[maxLevel];
+		find(pos, update, updatePos);
+
+		SkipNode<T>* tower = nullptr;
+		for (int i = 0; i < maxLevel; ++i)
+		{
+			SkipNode<T>* next = update[i]->next[i];
+			if (next && updatePos[i] + update[i]->width[i] == pos)
+			{
+				tower = next;
+				update[i]->width[i] += next->width[i] - 1;
+				update[i]->next[i] = next->next[i];
+			}
+			else
+				--update[i]->width[i];
+		}
+		delete tower;
+	}
+};
+
 template<class T>
 class  DoublyLinkedList
 {
 	int size;
 	Node<T>* head;
 	Node<T>* tail;
-public:
-	DoublyLinkedList()
-	{
-		head = tail = nullptr;
-		size = 0;
-	}
-	void push_back(T value)
+
+	// Last node found by position, reused when it is the nearest start
+	Node<T>* finger;
+	int fingerPos;
+
+	SkipIndex<T>* index;
+
+	// Node at pos, walking from the nearest of head, tail and finger,
+	// or descending the skip index when it is enabled
+	Node<T>* locate(int pos)
 	{
-		Node<T>* newNode = new Node<T>(value);
-		if (!tail)
+		if (pos < 0 || pos >= size) return nullptr;
+
+		Node<T>* newNode;
+		int from;
+		if (index)
+			newNode = index->nearest(pos, head, from);
+		else if (pos <= size - 1 - pos)
 		{
-			tail = newNode;
-			head = tail;
+			newNode = head;
+			from = 0;
 		}
 		else
-		{		
-			tail->next = newNode;
-			newNode->prev = tail;
-			tail = newNode;
+		{
+			newNode = tail;
+			from = size - 1;
 		}
-		++size;
+
+		if (finger && std::abs(fingerPos - pos) < std::abs(from - pos))
+		{
+			newNode = finger;
+			from = fingerPos;
+		}
+
+		for (; from < pos; ++from) newNode = newNode->next;
+		for (; from > pos; --from) newNode = newNode->prev;
+
+		finger = newNode;
+		fingerPos = pos;
+		return newNode;
 	}
 
-	void push_front(T value)
+	void link_before(Node<T>* newNode, Node<T>* rightNode)
 	{
-		Node<T>* newNode = new Node<T>(value);
-		if (!head)
+		if (!rightNode)
 		{
-			head = newNode;
-			tail = head;
+			newNode->prev = tail;
+			if (tail) tail->next = newNode;
+			else head = newNode;
+			tail = newNode;
 		}
 		else
 		{
-			head->prev = newNode;
-			newNode->next = head;
-			head = newNode;
+			newNode->next = rightNode;
+			newNode->prev = rightNode->prev;
+			if (rightNode->prev) rightNode->prev->next = newNode;
+			else head = newNode;
+			rightNode->prev = newNode;
 		}
 		++size;
 	}
 
+	void unlink(Node<T>* node)
+	{
+		if (node->prev) node->prev->next = node->next;
+		else head = node->next;
+		if (node->next) node->next->prev = node->prev;
+		else tail = node->prev;
+		--size;
+	}
+
+public:
+	DoublyLinkedList()
+	{
+		head = tail = nullptr;
+		size = 0;
+		finger = nullptr;
+		fingerPos = 0;
+		index = nullptr;
+	}
+
+	DoublyLinkedList(const DoublyLinkedList&) = delete;
+	DoublyLinkedList& operator=(const DoublyLinkedList&) = delete;
+
+	~DoublyLinkedList()
+	{
+		delete index;
+		while (head)
+		{
+			Node<T>* next = head->next;
+			delete head;
+			head = next;
+		}
+	}
+
+	// Builds the skip index; positional operations become O(log n)
+	void enable_index()
+	{
+		if (index) return;
+		index = new SkipIndex<T>(0);
+		int pos = 0;
+		for (Node<T>* newNode = head; newNode; newNode = newNode->next)
+			index->inserted(pos++, newNode);
+	}
+
+	void disable_index()
+	{
+		delete index;
+		index = nullptr;
+	}
+
+	void push_back(T value)
+	{
+		insert(size, value);
+	}
+
+	void push_front(T value)
+	{
+		insert(0, value);
+	}
+
 	void display()
 	{
 		Node<T>* newNode = head;
@@ -70,98 +293,707 @@ public:
 
 	void pop_front()
 	{
-		if (!head)return;
-		Node<T>* newNode = head;
-
-		head = newNode->next;
-		head->prev = nullptr;
-		delete newNode;
-		--size;
+		erase(0);
 	}
 
 	void pop_back()
 	{
-		if (!tail)return;
-		Node<T>* newNode = tail;
+		erase(size - 1);
+	}
+
+	Node<T>* at(int pos)
+	{
+		return locate(pos);
+	}
+
+	// Inserts before the element at pos; pos == size appends.
+	// Positions outside [0, size] are clamped.
+	void insert(int pos, T value)
+	{
+		if (pos < 0) pos = 0;
+		if (pos > size) pos = size;
+
+		Node<T>* rightNode = pos == size ? nullptr : locate(pos);
+		Node<T>* newNode = new Node<T>(value);
+		link_before(newNode, rightNode);
+
+		if (finger && fingerPos >= pos) ++fingerPos;
+		if (index) index->inserted(pos, newNode);
+	}
 
-		tail = newNode->prev;
-		tail->next = nullptr;
+	void erase(int pos)
+	{
+		Node<T>* newNode = locate(pos);
+		if (!newNode) return;
+
+		if (index) index->erased(pos);
+		unlink(newNode);
+
+		if (finger == newNode) finger = nullptr;
+		else if (finger && fingerPos > pos) --fingerPos;
 		delete newNode;
-		--size;
 	}
 
-	Node<T>* at(int pos)
+	int length()
 	{
+		return size;
+	}
 
-			Node<T>* newNode = head;
-			int counter = 0;
-			while (newNode)
+	Node<T>* front()
+	{
+		return head;
+	}
+	Node<T>* back()
+	{
+		return tail;
+	}
+};
+
+// Node of the unrolled list: up to N elements stored contiguously
+template<class T, int N>
+struct UnrolledNode
+{
+	alignas(T) unsigned char storage[sizeof(T) * N];
+	UnrolledNode<T, N>* next = nullptr;
+	UnrolledNode<T, N>* prev = nullptr;
+	int count = 0;
+
+	T* slot(int i) { return reinterpret_cast<T*>(storage) + i; }
+
+	void insert_at(int off, T&& value)
+	{
+		if (off == count)
+			new (slot(count)) T(std::move(value));
+		else
+		{
+			new (slot(count)) T(std::move(*slot(count - 1)));
+			for (int i = count - 1; i > off; --i)
+				*slot(i) = std::move(*slot(i - 1));
+			*slot(off) = std::move(value);
+		}
+		++count;
+	}
+
+	void erase_at(int off)
+	{
+		for (int i = off; i < count - 1; ++i)
+			*slot(i) = std::move(*slot(i + 1));
+		slot(count - 1)->~T();
+		--count;
+	}
+
+	// Moves elements [from, count) to the end of dst
+	void move_tail(int from, UnrolledNode<T, N>* dst)
+	{
+		for (int i = from; i < count; ++i)
+		{
+			new (dst->slot(dst->count++)) T(std::move(*slot(i)));
+			slot(i)->~T();
+		}
+		count = from;
+	}
+};
+
+// Doubly linked list of small arrays. Scans touch N elements per node,
+// full nodes split in half on insert and sparse nodes merge with their
+// successor on erase; whole lists still splice in O(1).
+template<class T, int N = 16>
+class UnrolledList
+{
+	static_assert(N >= 4, "node too small to split");
+
+	UnrolledNode<T, N>* head;
+	UnrolledNode<T, N>* tail;
+	int size;
+
+	UnrolledNode<T, N>* new_node_after(UnrolledNode<T, N>* node)
+	{
+		UnrolledNode<T, N>* newNode = new UnrolledNode<T, N>();
+		newNode->prev = node;
+		newNode->next = node ? node->next : head;
+		if (newNode->next) newNode->next->prev = newNode;
+		else tail = newNode;
+		if (node) node->next = newNode;
+		else head = newNode;
+		return newNode;
+	}
+
+	void remove_node(UnrolledNode<T, N>* node)
+	{
+		if (node->prev) node->prev->next = node->next;
+		else head = node->next;
+		if (node->next) node->next->prev = node->prev;
+		else tail = node->prev;
+		delete node;
+	}
+
+	// Node holding position pos, walking from the nearer end
+	UnrolledNode<T, N>* find(int pos, int& off)
+	{
+		UnrolledNode<T, N>* node;
+		if (pos < size / 2)
+		{
+			node = head;
+			while (pos >= node->count)
+			{
+				pos -= node->count;
+				node = node->next;
+			}
+		}
+		else
+		{
+			node = tail;
+			pos = size - 1 - pos;
+			while (pos >= node->count)
+			{
+				pos -= node->count;
+				node = node->prev;
+			}
+			pos = node->count - 1 - pos;
+		}
+		off = pos;
+		return node;
+	}
+
+	void insert_into(UnrolledNode<T, N>* node, int off, T&& value)
+	{
+		if (node->count == N)
+		{
+			UnrolledNode<T, N>* right = new_node_after(node);
+			node->move_tail(N / 2, right);
+			if (off > N / 2)
 			{
-				if (counter == pos) return newNode;
-				newNode = newNode->next;
-				++counter;
+				node = right;
+				off -= N / 2;
 			}
-			newNode == nullptr;
-			return newNode;
+		}
+		node->insert_at(off, std::move(value));
+		++size;
+	}
 
+public:
+	UnrolledList()
+	{
+		head = tail = nullptr;
+		size = 0;
 	}
 
-	void insert(int pos, T value)
+	UnrolledList(const UnrolledList&) = delete;
+	UnrolledList& operator=(const UnrolledList&) = delete;
+
+	~UnrolledList()
 	{
-		if (!pos || !head) push_front(value);
-		else if (pos == size)push_back(value);
-		else
+		clear();
+	}
+
+	void clear()
+	{
+		while (head)
 		{
-			Node<T>* newNode = new Node<T>(value);
+			UnrolledNode<T, N>* next = head->next;
+			for (int i = 0; i < head->count; ++i)
+				head->slot(i)->~T();
+			delete head;
+			head = next;
+		}
+		tail = nullptr;
+		size = 0;
+	}
 
-			Node<T>* leftNode = at(pos - 1);
-			Node<T>* rightNode = at(pos);
+	void push_back(T value)
+	{
+		if (!tail || tail->count == N)
+			new_node_after(tail);
+		tail->insert_at(tail->count, std::move(value));
+		++size;
+	}
 
-			if (!leftNode || !rightNode) return;
+	void push_front(T value)
+	{
+		if (!head || head->count == N)
+			new_node_after(nullptr);
+		head->insert_at(0, std::move(value));
+		++size;
+	}
 
-			newNode->next = rightNode;
-			newNode->prev = leftNode;
+	// Inserts before the element at pos; positions outside [0, size] are clamped
+	void insert(int pos, T value)
+	{
+		if (pos <= 0) return push_front(std::move(value));
+		if (pos >= size) return push_back(std::move(value));
 
-			rightNode->prev = newNode;
-			leftNode->next = newNode;
+		int off;
+		UnrolledNode<T, N>* node = find(pos, off);
+		// Prefer the end of the previous node when pos starts this one
+		if (!off && node->prev && node->prev->count < N)
+		{
+			node = node->prev;
+			off = node->count;
 		}
-		
+		insert_into(node, off, std::move(value));
 	}
 
 	void erase(int pos)
 	{
-		if (!head) return;
-		if (!pos)pop_front();
-		if (pos == size-1)pop_back();
-		else
+		if (pos < 0 || pos >= size) return;
+
+		int off;
+		UnrolledNode<T, N>* node = find(pos, off);
+		node->erase_at(off);
+		--size;
+
+		if (!node->count)
+			remove_node(node);
+		else if (node->count < N / 4)
 		{
-			Node<T>* leftNode = at(pos-1);
+			UnrolledNode<T, N>* next = node->next;
+			if (next && node->count + next->count <= N)
+			{
+				next->move_tail(0, node);
+				remove_node(next);
+			}
+			else if (node->prev && node->prev->count + node->count <= N)
+			{
+				node->move_tail(0, node->prev);
+				remove_node(node);
+			}
+		}
+	}
 
-			Node<T>* rightNode = at(pos+1);
-			
-			Node<T>* newNode = at(pos);
-		
-			if (!leftNode || !rightNode || !newNode) return;
+	void pop_front()
+	{
+		erase(0);
+	}
 
-			leftNode->next = rightNode;
-			rightNode->prev = leftNode;
-			delete newNode;
+	void pop_back()
+	{
+		erase(size - 1);
+	}
+
+	T* at(int pos)
+	{
+		if (pos < 0 || pos >= size) return nullptr;
+		int off;
+		return find(pos, off)->slot(off);
+	}
+
+	T* front()
+	{
+		return head ? head->slot(0) : nullptr;
+	}
+
+	T* back()
+	{
+		return tail ? tail->slot(tail->count - 1) : nullptr;
+	}
+
+	// Moves every element of other to the end of this list without copying
+	void splice(UnrolledList& other)
+	{
+		if (!other.head || &other == this) return;
+		if (tail) tail->next = other.head;
+		else head = other.head;
+		other.head->prev = tail;
+		tail = other.tail;
+		size += other.size;
+		other.head = other.tail = nullptr;
+		other.size = 0;
+	}
+
+	template<class F>
+	void for_each(F f)
+	{
+		for (UnrolledNode<T, N>* node = head; node; node = node->next)
+			for (int i = 0; i < node->count; ++i)
+				f(*node->slot(i));
+	}
+
+	void display()
+	{
+		for_each([](const T& value) { std::cout << value << "\n"; });
+	}
+
+	int length()
+	{
+		return size;
+	}
+};
+
+// Links embedded in a user type for IntrusiveList. Debug builds also
+// record the owning list, so linking an item twice or unlinking it from
+// the wrong list aborts instead of corrupting both lists.
+template<class T>
+struct ListHook
+{
+	T* next = nullptr;
+	T* prev = nullptr;
+#ifndef NDEBUG
+	const void* owner = nullptr;
+#endif
+};
+
+// Doubly linked list over items that carry their own ListHook member.
+// The list never allocates or copies; items stay owned by the caller
+// and every link or unlink is O(1).
+template<class T, ListHook<T> T::*Hook>
+class IntrusiveList
+{
+	T* head;
+	T* tail;
+	int size;
+
+	static ListHook<T>& hook(T* item)
+	{
+		return item->*Hook;
+	}
+
+	void check_owner(T& item, const void* expected, const char* message)
+	{
+#ifndef NDEBUG
+		if (hook(&item).owner != expected)
+		{
+			std::cout << message << std::endl;
+			abort();
 		}
+#else
+		(void)item; (void)expected; (void)message;
+#endif
+	}
 
+	void set_owner(T& item, const void* owner)
+	{
+#ifndef NDEBUG
+		hook(&item).owner = owner;
+#else
+		(void)item; (void)owner;
+#endif
 	}
 
-	Node<T>* front()
+public:
+	IntrusiveList()
 	{
-		if (!head) return nullptr;
-		return head->data;
+		head = tail = nullptr;
+		size = 0;
 	}
-	Node<T>* back()
+
+	IntrusiveList(const IntrusiveList&) = delete;
+	IntrusiveList& operator=(const IntrusiveList&) = delete;
+
+	~IntrusiveList()
 	{
-		if (!tail) return nullptr;
-		return tail->data;
+		clear();
+	}
+
+	void push_front(T& item)
+	{
+		check_owner(item, nullptr, "Item is already linked");
+		set_owner(item, this);
+		ListHook<T>& h = hook(&item);
+		h.prev = nullptr;
+		h.next = head;
+		if (head) hook(head).prev = &item;
+		else tail = &item;
+		head = &item;
+		++size;
+	}
+
+	void push_back(T& item)
+	{
+		check_owner(item, nullptr, "Item is already linked");
+		set_owner(item, this);
+		ListHook<T>& h = hook(&item);
+		h.next = nullptr;
+		h.prev = tail;
+		if (tail) hook(tail).next = &item;
+		else head = &item;
+		tail = &item;
+		++size;
+	}
+
+	void erase(T& item)
+	{
+		check_owner(item, this, "Item is not linked into this list");
+		set_owner(item, nullptr);
+		ListHook<T>& h = hook(&item);
+		if (h.prev) hook(h.prev).next = h.next;
+		else head = h.next;
+		if (h.next) hook(h.next).prev = h.prev;
+		else tail = h.prev;
+		h.next = h.prev = nullptr;
+		--size;
+	}
+
+	void move_to_front(T& item)
+	{
+		if (head == &item) return;
+		erase(item);
+		push_front(item);
+	}
+
+	T* pop_front()
+	{
+		T* item = head;
+		if (item) erase(*item);
+		return item;
+	}
+
+	T* pop_back()
+	{
+		T* item = tail;
+		if (item) erase(*item);
+		return item;
+	}
+
+	T* front()
+	{
+		return head;
+	}
+
+	T* back()
+	{
+		return tail;
+	}
+
+	static T* next(T& item)
+	{
+		return hook(&item).next;
+	}
+
+	static T* prev(T& item)
+	{
+		return hook(&item).prev;
+	}
+
+	// Unlinks every item; the items themselves are left alone
+	void clear()
+	{
+		while (head)
+			erase(*head);
+	}
+
+	template<class F>
+	void for_each(F f)
+	{
+		for (T* item = head; item; item = hook(item).next)
+			f(*item);
+	}
+
+	int length()
+	{
+		return size;
+	}
+
+	bool empty()
+	{
+		return size == 0;
 	}
 };
 
+template<class F>
+double measure_ms(F&& f)
+{
+	auto start = std::chrono::steady_clock::now();
+	f();
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Random insert/erase/at by position on a long list
+void bench_positional()
+{
+	const int n = 200000;
+
+	for (int mode = 0; mode < 2; ++mode)
+	{
+		const int ops = mode ? 200000 : 2000;
+		DoublyLinkedList<int> list;
+		std::list<int> reference;
+		for (int i = 0; i < n; ++i)
+		{
+			list.push_back(i);
+			if (mode == 0) reference.push_back(i);
+		}
+		if (mode) list.enable_index();
+
+		uint32_t seed = 12345;
+		long long sum = 0;
+		double ms = measure_ms([&] {
+			for (int i = 0; i < ops; ++i)
+			{
+				seed = seed * 1664525u + 1013904223u;
+				int pos = (seed >> 8) % list.length();
+				switch (i % 3)
+				{
+				case 0: list.insert(pos, i); break;
+				case 1: list.erase(pos); break;
+				default: sum += list.at(pos)->data;
+				}
+			}
+		});
+		const char* name[] = { "walk from nearest end", "skip index" };
+		std::cout << name[mode] << ": " << ops << " ops in " << ms << " ms, "
+			<< ms * 1000.0 / ops << " us/op (" << sum << ")\n";
+
+		if (mode == 0)
+		{
+			seed = 12345;
+			sum = 0;
+			ms = measure_ms([&] {
+				for (int i = 0; i < ops; ++i)
+				{
+					seed = seed * 1664525u + 1013904223u;
+					int pos = (seed >> 8) % reference.size();
+					auto it = reference.begin();
+					std::advance(it, pos);
+					switch (i % 3)
+					{
+					case 0: reference.insert(it, i); break;
+					case 1: reference.erase(it); break;
+					default: sum += *it;
+					}
+				}
+			});
+			std::cout << "std::list: " << ops << " ops in " << ms << " ms, "
+				<< ms * 1000.0 / ops << " us/op (" << sum << ")\n";
+		}
+	}
+}
+
+// Full scans and inserts: node list vs unrolled list vs std::list
+void bench_unrolled()
+{
+	const int n = 1000000;
+	const int edits = 1000;
+
+	DoublyLinkedList<int> list;
+	UnrolledList<int> unrolled;
+	std::list<int> reference;
+
+	double build[3] = {
+		measure_ms([&] { for (int i = 0; i < n; ++i) list.push_back(i); }),
+		measure_ms([&] { for (int i = 0; i < n; ++i) unrolled.push_back(i); }),
+		measure_ms([&] { for (int i = 0; i < n; ++i) reference.push_back(i); })
+	};
+
+	long long sum[3] = {};
+	double scan[3] = {
+		measure_ms([&] {
+			for (int r = 0; r < 10; ++r)
+				for (Node<int>* node = list.front(); node; node = node->next)
+					sum[0] += node->data;
+		}),
+		measure_ms([&] {
+			for (int r = 0; r < 10; ++r)
+				unrolled.for_each([&](int value) { sum[1] += value; });
+		}),
+		measure_ms([&] {
+			for (int r = 0; r < 10; ++r)
+				for (int value : reference)
+					sum[2] += value;
+		})
+	};
+
+	uint32_t seeds[3] = { 99, 99, 99 };
+	auto next_pos = [](uint32_t& seed, int size) {
+		seed = seed * 1664525u + 1013904223u;
+		return int((seed >> 8) % (size + 1));
+	};
+	double insert[3] = {
+		measure_ms([&] {
+			for (int i = 0; i < edits; ++i)
+				list.insert(next_pos(seeds[0], list.length()), i);
+		}),
+		measure_ms([&] {
+			for (int i = 0; i < edits; ++i)
+				unrolled.insert(next_pos(seeds[1], unrolled.length()), i);
+		}),
+		measure_ms([&] {
+			for (int i = 0; i < edits; ++i)
+			{
+				auto it = reference.begin();
+				std::advance(it, next_pos(seeds[2], int(reference.size())));
+				reference.insert(it, i);
+			}
+		})
+	};
+
+	const char* name[] = { "DoublyLinkedList", "UnrolledList", "std::list" };
+	for (int i = 0; i < 3; ++i)
+		std::cout << name[i] << ": push_back " << build[i] << " ms, 10 scans "
+			<< scan[i] << " ms, " << edits << " random inserts " << insert[i]
+			<< " ms (" << sum[i] << ")\n";
+}
+
+struct CacheEntry
+{
+	int key;
+	long long payload[6];
+	ListHook<CacheEntry> hook;
+};
+
+// LRU-style churn over pooled entries: every access moves the entry to
+// the front. The copying variant erases and reinserts a node per access.
+void bench_lru_churn()
+{
+	const int n = 100000;
+	const int ops = 2000000;
+
+	std::vector<CacheEntry> pool(n);
+	for (int i = 0; i < n; ++i)
+		pool[i].key = i;
+
+	auto next_key = [](uint32_t& seed) {
+		seed = seed * 1664525u + 1013904223u;
+		// Three accesses in four go to the hottest tenth of the keys
+		int r = int(seed >> 8);
+		return (r & 7) < 6 ? r / 8 % (n / 10) : r / 8 % n;
+	};
+
+	long long sum = 0;
+	uint32_t seed = 7;
+	IntrusiveList<CacheEntry, &CacheEntry::hook> lru;
+	for (CacheEntry& entry : pool) lru.push_back(entry);
+	double intrusive_ms = measure_ms([&] {
+		for (int i = 0; i < ops; ++i)
+		{
+			CacheEntry& entry = pool[next_key(seed)];
+			lru.move_to_front(entry);
+			sum += lru.back()->key;
+		}
+	});
+	lru.clear();
+
+	seed = 7;
+	std::list<CacheEntry> spliced;
+	std::vector<std::list<CacheEntry>::iterator> where(n);
+	for (int i = 0; i < n; ++i) where[i] = spliced.insert(spliced.end(), pool[i]);
+	double splice_ms = measure_ms([&] {
+		for (int i = 0; i < ops; ++i)
+		{
+			int key = next_key(seed);
+			spliced.splice(spliced.begin(), spliced, where[key]);
+			sum += spliced.back().key;
+		}
+	});
+
+	seed = 7;
+	std::list<CacheEntry> copied(spliced.begin(), spliced.end());
+	for (auto it = copied.begin(); it != copied.end(); ++it) where[it->key] = it;
+	double copy_ms = measure_ms([&] {
+		for (int i = 0; i < ops; ++i)
+		{
+			int key = next_key(seed);
+			CacheEntry entry = *where[key];
+			copied.erase(where[key]);
+			where[key] = copied.insert(copied.begin(), entry);
+			sum += copied.back().key;
+		}
+	});
+
+	std::cout << "LRU churn, " << ops << " accesses: IntrusiveList " << intrusive_ms
+		<< " ms, std::list splice " << splice_ms << " ms, std::list copy "
+		<< copy_ms << " ms (" << sum << ")\n";
+}
+
 int main()
 {
 	DoublyLinkedList<int> lox;
@@ -184,4 +1016,8 @@ int main()
 	lox.insert(-30, 525225);
 
 	lox.display();
+
+	bench_positional();
+	bench_unrolled();
+	bench_lru_churn();
 }
@@ -10,6 +10,10 @@
 #include <chrono>
 #include <vector>
 #include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <new>
 
 
 
@@ -138,6 +142,360 @@ public:
 
 };
 
-int main() {
+struct CacheStats
+{
+	size_t hits = 0;
+	size_t misses = 0;
+	size_t evictions = 0;
+};
+
+// LRU keeps one recency list. TwoQ admits new keys to a probation FIFO
+// and promotes them on their second hit, so a one-off scan cannot flush
+// the hot set; keys evicted from probation are remembered as ghosts and
+// go straight to the main list when they come back.
+enum class CachePolicy { LRU, TwoQ };
+
+// Bounded cache with O(1) get/put/evict. Each entry sits on a hash
+// bucket chain for lookup and on a doubly linked recency list for
+// eviction order, so a hit relinks two pointers and allocates nothing.
+// Capacity is in bytes; put() takes the weight of each entry.
+template<class K, class V, class Hash = std::hash<K>>
+class LruCache
+{
+	enum { Main, Probation, Ghost };
+
+	struct Entry
+	{
+		K key;
+		size_t hash;
+		size_t bytes;
+		int list;
+		Entry* chain;
+		Entry* next;
+		Entry* prev;
+		alignas(V) unsigned char storage[sizeof(V)];
+
+		Entry(const K& key, size_t hash) :key(key), hash(hash), bytes(0), list(Main),
+			chain(nullptr), next(nullptr), prev(nullptr) {}
+		V& value() { return *reinterpret_cast<V*>(storage); }
+	};
+
+	struct Recency
+	{
+		Entry* head = nullptr;
+		Entry* tail = nullptr;
+		size_t bytes = 0;
+		size_t count = 0;
+	};
+
+	std::vector<Entry*> buckets;
+	size_t entries;
+	Recency lists[3];
+
+	size_t capacityBytes;
+	CachePolicy policy;
+	Hash hasher;
+	std::function<void(const K&, V&)> onEvict;
+	CacheStats counters;
+
+	size_t hash_of(const K& key) const
+	{
+		// splitmix64 finalizer, std::hash may be the identity
+		uint64_t h = hasher(key);
+		h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ull;
+		h = (h ^ (h >> 27)) * 0x94d049bb133111ebull;
+		return size_t(h ^ (h >> 31));
+	}
+
+	Entry** slot(const K& key, size_t hash)
+	{
+		Entry** link = &buckets[hash & (buckets.size() - 1)];
+		while (*link && ((*link)->hash != hash || !((*link)->key == key)))
+			link = &(*link)->chain;
+		return link;
+	}
+
+	void rehash()
+	{
+		std::vector<Entry*> old(buckets.size() * 2, nullptr);
+		old.swap(buckets);
+		for (Entry* e : old)
+			while (e)
+			{
+				Entry* chain = e->chain;
+				Entry*& bucket = buckets[e->hash & (buckets.size() - 1)];
+				e->chain = bucket;
+				bucket = e;
+				e = chain;
+			}
+	}
+
+	void link_front(Entry* e, int list)
+	{
+		Recency& r = lists[list];
+		e->list = list;
+		e->prev = nullptr;
+		e->next = r.head;
+		if (r.head) r.head->prev = e;
+		else r.tail = e;
+		r.head = e;
+		r.bytes += e->bytes;
+		++r.count;
+	}
+
+	void unlink(Entry* e)
+	{
+		Recency& r = lists[e->list];
+		if (e->prev) e->prev->next = e->next;
+		else r.head = e->next;
+		if (e->next) e->next->prev = e->prev;
+		else r.tail = e->prev;
+		r.bytes -= e->bytes;
+		--r.count;
+	}
+
+	// Unlinks e from both structures and frees it
+	void remove(Entry* e)
+	{
+		unlink(e);
+		Entry** link = slot(e->key, e->hash);
+		*link = e->chain;
+		if (e->list != Ghost) e->value().~V();
+		delete e;
+		--entries;
+	}
+
+	size_t used() const
+	{
+		return lists[Main].bytes + lists[Probation].bytes;
+	}
+
+	// Never picks keep, the entry being put; it fits on its own, so while
+	// the cache is over capacity the other list has a victim
+	void evict_one(const Entry* keep)
+	{
+		Recency& probation = lists[Probation];
+		bool fromProbation = probation.count &&
+			(probation.bytes > capacityBytes / 4 || !lists[Main].count);
+		Entry* victim = fromProbation ? probation.tail : lists[Main].tail;
+		if (victim == keep)
+		{
+			fromProbation = !fromProbation;
+			victim = fromProbation ? probation.tail : lists[Main].tail;
+		}
+
+		++counters.evictions;
+		if (onEvict) onEvict(victim->key, victim->value());
+
+		if (!fromProbation)
+		{
+			remove(victim);
+			return;
+		}
+
+		// Keep the key as a ghost, bounded to half the live entries
+		unlink(victim);
+		victim->value().~V();
+		victim->bytes = 0;
+		link_front(victim, Ghost);
+		size_t live = lists[Main].count + lists[Probation].count;
+		while (lists[Ghost].count > live / 2 + 1)
+			remove(lists[Ghost].tail);
+	}
+
+public:
+	explicit LruCache(size_t capacityBytes, CachePolicy policy = CachePolicy::LRU)
+		:buckets(16, nullptr), entries(0), capacityBytes(capacityBytes), policy(policy) {}
+
+	LruCache(const LruCache&) = delete;
+	LruCache& operator=(const LruCache&) = delete;
+
+	~LruCache()
+	{
+		clear();
+	}
+
+	// Called with each entry pushed out by capacity, before it is destroyed
+	void set_eviction_callback(std::function<void(const K&, V&)> callback)
+	{
+		onEvict = std::move(callback);
+	}
+
+	// Returns the cached value and marks it most recently used, or nullptr
+	V* get(const K& key)
+	{
+		Entry* e = *slot(key, hash_of(key));
+		if (!e || e->list == Ghost)
+		{
+			++counters.misses;
+			return nullptr;
+		}
+		++counters.hits;
+		if (e != lists[Main].head)
+		{
+			unlink(e);
+			link_front(e, Main);
+		}
+		return &e->value();
+	}
+
+	// Inserts or replaces key; entries heavier than the whole cache are refused
+	bool put(const K& key, V value, size_t bytes = sizeof(K) + sizeof(V))
+	{
+		if (bytes > capacityBytes) return false;
+
+		size_t hash = hash_of(key);
+		Entry** link = slot(key, hash);
+		Entry* e = *link;
+		int list = policy == CachePolicy::LRU ? Main : Probation;
 
+		if (e)
+		{
+			if (e->list == Ghost)
+			{
+				list = Main;
+				new (e->storage) V(std::move(value));
+			}
+			else
+			{
+				e->value() = std::move(value);
+				if (e->list == Main) list = Main;
+			}
+			unlink(e);
+		}
+		else
+		{
+			// Owned here until linked, in case the rehash or V's
+			// constructor throws; V goes in last, so nothing else can
+			// fail once it exists
+			std::unique_ptr<Entry> fresh(new Entry(key, hash));
+			if (entries + 1 > buckets.size())
+			{
+				rehash();
+				link = slot(key, hash);
+			}
+			new (fresh->storage) V(std::move(value));
+			e = fresh.release();
+			e->chain = *link;
+			*link = e;
+			++entries;
+		}
+		e->bytes = bytes;
+		link_front(e, list);
+
+		while (used() > capacityBytes)
+			evict_one(e);
+		return true;
+	}
+
+	bool contains(const K& key)
+	{
+		Entry* e = *slot(key, hash_of(key));
+		return e && e->list != Ghost;
+	}
+
+	// Drops key without calling the eviction callback
+	bool erase(const K& key)
+	{
+		Entry* e = *slot(key, hash_of(key));
+		if (!e || e->list == Ghost) return false;
+		remove(e);
+		return true;
+	}
+
+	void clear()
+	{
+		for (int list = Main; list <= Ghost; ++list)
+			while (lists[list].head)
+				remove(lists[list].head);
+	}
+
+	size_t size() const
+	{
+		return lists[Main].count + lists[Probation].count;
+	}
+
+	size_t bytes() const
+	{
+		return used();
+	}
+
+	size_t capacity() const
+	{
+		return capacityBytes;
+	}
+
+	const CacheStats& stats() const
+	{
+		return counters;
+	}
+};
+
+template <class F>
+double measure_ms(F&& fn)
+{
+	auto start = std::chrono::steady_clock::now();
+	fn();
+	auto stop = std::chrono::steady_clock::now();
+	return std::chrono::duration<double, std::milli>(stop - start).count();
+}
+
+// Keys 0..n-1 drawn with probability proportional to 1 / (rank + 1)^s
+std::vector<int> zipf_trace(int n, int length, double s, uint64_t seed)
+{
+	std::vector<double> cdf(n);
+	double total = 0;
+	for (int i = 0; i < n; ++i)
+	{
+		total += 1.0 / std::pow(i + 1.0, s);
+		cdf[i] = total;
+	}
+
+	std::vector<int> trace(length);
+	for (int i = 0; i < length; ++i)
+	{
+		seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+		double u = double(seed >> 11) / double(1ull << 53) * total;
+		trace[i] = int(std::lower_bound(cdf.begin(), cdf.end(), u) - cdf.begin());
+	}
+	return trace;
+}
+
+// Read-through cache in front of a backend: get, and put on a miss
+void bench_cache()
+{
+	const int keys = 1000000;
+	const int length = 4000000;
+	const size_t entryBytes = 64;
+
+	std::vector<int> zipf = zipf_trace(keys, length, 0.99, 42);
+	// Same trace with a one-off sequential scan over cold keys every 200k accesses
+	std::vector<int> scans = zipf;
+	for (int i = 0; i + 200000 <= length; i += 200000)
+		for (int j = 0; j < 20000; ++j)
+			scans[i + j] = keys + i / 10 + j;
+
+	const char* traceName[] = { "zipf 0.99", "zipf + scans" };
+	const std::vector<int>* traces[] = { &zipf, &scans };
+	for (int t = 0; t < 2; ++t)
+		for (int percent : { 1, 5, 10 })
+			for (CachePolicy policy : { CachePolicy::LRU, CachePolicy::TwoQ })
+			{
+				LruCache<int, std::string> cache(keys / 100 * percent * entryBytes, policy);
+				const std::vector<int>& trace = *traces[t];
+				double ms = measure_ms([&] {
+					for (int key : trace)
+						if (!cache.get(key))
+							cache.put(key, "value", entryBytes);
+				});
+				const CacheStats& s = cache.stats();
+				std::cout << traceName[t] << ", " << percent << "% of keys, "
+					<< (policy == CachePolicy::LRU ? "LRU " : "2Q  ") << ": hit rate "
+					<< 100.0 * s.hits / (s.hits + s.misses) << "%, "
+					<< length / ms / 1000.0 << " M ops/s, " << s.evictions << " evictions\n";
+			}
+}
+
+int main() {
+	bench_cache();
 }
\ No newline at end of file
@@ -6,153 +6,44 @@
 #include <algorithm>
 #include <queue>
 #include <vector>
+#include "../SmartPointers/SharedPtr.h"
 
-template<typename T>
-class Shared_ptr {
-public:
-	using element_type = T;
-
-	Shared_ptr() : ptr_(nullptr), ref_count(nullptr) {}
-
-	explicit Shared_ptr(T* p) : ptr_(p), ref_count(new int(1)) {}
-
-	Shared_ptr(const Shared_ptr<T>& other) : ptr_(other.ptr_), ref_count(other.ref_count) {
-		if (ref_count) {
-			++(*ref_count);
-		}
-	}
-
-	Shared_ptr(Shared_ptr<T>&& other) : ptr_(nullptr), ref_count(nullptr) {
-		swap(other);
-	}
-
-	Shared_ptr& operator=(const Shared_ptr& sp) noexcept {
-		if (ptr_ != sp.ptr_) {
-			release();
-			ptr_ = sp.ptr_;
-			ref_count = sp.ref_count;
-			if (ref_count) {
-				++(*ref_count);
-			}
-		}
-		return *this;
-	}
-
-	Shared_ptr& operator=(std::nullptr_t)
-	{
-		reset();
-		return *this;
-	}
+// What a tree node needs for each kind of link: a base holding the count
+// (empty for Shared_ptr) and a way to create the node
+template<template<typename...> class Link>
+struct LinkTraits;
 
-	Shared_ptr& operator=(Shared_ptr&& sp) noexcept {
-		if (ptr_ != sp.ptr_) {
-			release();
-			std::swap(ptr_, sp.ptr_);
-			std::swap(ref_count, sp.ref_count);
-		}
-		return *this;
-	}
-
-	template <class Other>
-	Shared_ptr& operator=(const Shared_ptr<Other>& sp) noexcept {
-		release();
-		ptr_ = sp.ptr_;
-		ref_count = sp.ref_count;
-		if (ref_count) {
-			++(*ref_count);
-		}
-		return *this;
-	}
-
-	template <class Other>
-	Shared_ptr& operator=(Shared_ptr<Other>&& sp) noexcept {
-		release();
-		std::swap(ptr_, sp.ptr_);
-		std::swap(ref_count, sp.ref_count);
-		return *this;
-	}
-
-	~Shared_ptr() {
-		release();
-	}
-
-	T* get() const noexcept {
-		return ptr_;
-	}
+template<>
+struct LinkTraits<Shared_ptr> {
+	struct Base {};
 
-	void reset(T* p = nullptr) {
-		release();
-		ptr_ = p;
-		ref_count = new int(1);
-	}
-
-	void swap(Shared_ptr<T>& other) {
-		std::swap(ptr_, other.ptr_);
-		std::swap(ref_count, other.ref_count);
-	}
-
-
-	explicit operator bool() const noexcept {
-		return ptr_ != nullptr;
-	}
-
-
-
-	T* operator->() const {
-		return ptr_;
-	}
-
-	bool operator==(std::nullptr_t) const noexcept {
-		return ptr_ == nullptr;
-	}
-
-	bool operator==(const Shared_ptr& ptr) const noexcept {
-		return ptr_ == ptr.ptr_;
-	}
-
-	bool operator!=(const Shared_ptr& ptr) const noexcept {
-		return ptr_ != ptr.ptr_;
+	template<typename T, typename... Args>
+	static Shared_ptr<T> make(Args&&... args) {
+		return Make_shared<T>(std::forward<Args>(args)...);
 	}
+};
 
-	friend std::ostream& operator<<(std::ostream& os, const Shared_ptr<T>& p) {
-		os << p.ptr_;
-		return os;
-	}
+template<>
+struct LinkTraits<IntrusivePtr> {
+	using Base = RefCounted<SingleThreaded>;
 
-	void release() {
-		if (ref_count) {
-			--(*ref_count);
-			if (*ref_count == 0) {
-				delete ptr_;
-				delete ref_count;
-			}
-			ptr_ = nullptr;
-			ref_count = nullptr;
-		}
+	template<typename T, typename... Args>
+	static IntrusivePtr<T> make(Args&&... args) {
+		return MakeIntrusive<T>(std::forward<Args>(args)...);
 	}
-
-private:
-	T* ptr_;
-	int* ref_count;
 };
 
-template<typename T, typename... Args>
-Shared_ptr<T> MakeShared(Args&&... args) {
-	return Shared_ptr<T>(new T(std::forward<Args>(args)...));
-}
-
-
 typedef bool color_type;
-template<class KeyType, class ValueType>
-struct Node {
+template<class KeyType, class ValueType, template<typename...> class Link = Shared_ptr>
+struct Node : LinkTraits<Link>::Base {
 
 	std::pair<KeyType, ValueType> container;
 
-	Shared_ptr<Node<KeyType, ValueType>> parent;
+	Link<Node> parent;
 
-	Shared_ptr<Node<KeyType, ValueType>> left;
+	Link<Node> left;
 
-	Shared_ptr<Node<KeyType, ValueType>> right;
+	Link<Node> right;
 
 	color_type color; // 1 -> Red, 0 -> Black
 	Node(KeyType key, ValueType value)
@@ -176,14 +67,17 @@ struct Node {
 
 };
 
-template<class KeyType, class ValueType>
+template<class KeyType, class ValueType, template<typename...> class Link = Shared_ptr>
 class Map {
+public:
+	using NodePtr = Link<Node<KeyType, ValueType, Link>>;
+
 private:
-	Shared_ptr<Node<KeyType, ValueType>> root;
+	NodePtr root;
 
-	Shared_ptr<Node<KeyType, ValueType>> nullptr_node;
+	NodePtr nullptr_node;
 
-	ValueType searchTreeHelper(Shared_ptr<Node<KeyType, ValueType>> node, KeyType key) {
+	ValueType searchTreeHelper(NodePtr node, KeyType key) {
 		if (node == nullptr_node || key == node->container.first) {
 			return  node->container.second;
 		}
@@ -195,8 +89,8 @@ private:
 	}
 
 
-	void getRotationColorChange(Shared_ptr<Node<KeyType, ValueType>> node) {
-		Shared_ptr<Node<KeyType, ValueType>> uncle_node;
+	void getRotationColorChange(NodePtr node) {
+		NodePtr uncle_node;
 		while (node->parent->color == true) {
 			if (node->parent == node->parent->parent->right) {
 				uncle_node = node->parent->parent->left; // uncle
@@ -248,8 +142,8 @@ private:
 		root->color = false;
 	}
 
-	void deleteFix(Shared_ptr<Node<KeyType, ValueType>> x) {
-		Shared_ptr<Node<KeyType, ValueType>> s;
+	void deleteFix(NodePtr x) {
+		NodePtr s;
 		while (x != root && x->color == 0) {
 			if (x == x->parent->left) {
 				s = x->parent->right;
@@ -311,7 +205,7 @@ private:
 		x->color = 0;
 	}
 
-	void rbTransplant(Shared_ptr<Node<KeyType, ValueType>> u, Shared_ptr<Node<KeyType, ValueType>> v) {
+	void rbTransplant(NodePtr u, NodePtr v) {
 		if (u->parent == nullptr) {
 			root = v;
 		}
@@ -324,9 +218,9 @@ private:
 		v->parent = u->parent;
 	}
 
-	void deleteNodeHelper(Shared_ptr<Node<KeyType, ValueType>> node, KeyType key) {
-		Shared_ptr<Node<KeyType, ValueType>>  z = nullptr_node;
-		Shared_ptr<Node<KeyType, ValueType>>  x, y;
+	void deleteNodeHelper(NodePtr node, KeyType key) {
+		NodePtr  z = nullptr_node;
+		NodePtr  x, y;
 		while (node != nullptr_node) {
 			if (node->container.first == key) {
 				z = node;
@@ -379,7 +273,7 @@ private:
 		}
 	}
 
-	void inOrderHelper(Shared_ptr<Node<KeyType, ValueType>> node) {
+	void inOrderHelper(NodePtr node) {
 		if (node != nullptr_node) {
 			inOrderHelper(node->left);
 			std::cout << node->container.second << " ";
@@ -390,7 +284,7 @@ private:
 
 public:
 	Map() {
-		nullptr_node = Shared_ptr<Node<KeyType, ValueType>>(new Node<KeyType, ValueType>());
+		nullptr_node = LinkTraits<Link>::template make<Node<KeyType, ValueType, Link>>();
 		nullptr_node->color = false;
 		nullptr_node->left = nullptr;
 		nullptr_node->right = nullptr;
@@ -401,26 +295,26 @@ public:
 		inOrderHelper(this->root);
 	}
 
-	Shared_ptr<Node<KeyType, ValueType>> minimum(Shared_ptr<Node<KeyType, ValueType>> node) {
+	NodePtr minimum(NodePtr node) {
 		while (node->left != nullptr_node) {
 			node = node->left;
 		}
 		return node;
 	}
 
-	Shared_ptr<Node<KeyType, ValueType>> maximum(Shared_ptr<Node<KeyType, ValueType>> node) {
+	NodePtr maximum(NodePtr node) {
 		while (node->right != nullptr_node) {
 			node = node->right;
 		}
 		return node;
 	}
 
-	Shared_ptr<Node<KeyType, ValueType>> successor(Shared_ptr<Node<KeyType, ValueType>> x) {
+	NodePtr successor(NodePtr x) {
 		if (x->right != nullptr_node) {
 			return minimum(x->right);
 		}
 
-		Shared_ptr<Node<KeyType, ValueType>> y = x->parent;
+		NodePtr y = x->parent;
 		while (y != nullptr_node && x == y->right) {
 			x = y;
 			y = y->parent;
@@ -428,12 +322,12 @@ public:
 		return y;
 	}
 
-	Shared_ptr<Node<KeyType, ValueType>> predecessor(Shared_ptr<Node<KeyType, ValueType>> x) {
+	NodePtr predecessor(NodePtr x) {
 		if (x->left != nullptr_node) {
 			return maximum(x->left);
 		}
 
-		Shared_ptr<Node<KeyType, ValueType>> y = x->parent;
+		NodePtr y = x->parent;
 		while (y != nullptr_node && x == y->left) {
 			x = y;
 			y = y->parent;
@@ -443,8 +337,8 @@ public:
 	}
 
 
-	void leftRotate(Shared_ptr<Node<KeyType, ValueType>> x) {
-		Shared_ptr<Node<KeyType, ValueType>> y = x->right;
+	void leftRotate(NodePtr x) {
+		NodePtr y = x->right;
 		x->right = y->left;
 		if (y->left != nullptr_node) {
 			y->left->parent = x;
@@ -463,8 +357,8 @@ public:
 		x->parent = y;
 	}
 
-	void rightRotate(Shared_ptr<Node<KeyType, ValueType>> x) {
-		Shared_ptr<Node<KeyType, ValueType>> y = x->left;
+	void rightRotate(NodePtr x) {
+		NodePtr y = x->left;
 		x->left = y->right;
 		if (y->right != nullptr_node) {
 			y->right->parent = x;
@@ -485,15 +379,15 @@ public:
 
 	void insert(KeyType key, ValueType value) {
 
-		Shared_ptr<Node<KeyType, ValueType>> node = Shared_ptr<Node<KeyType, ValueType>>(new Node<KeyType, ValueType>(key, value));
+		NodePtr node = LinkTraits<Link>::template make<Node<KeyType, ValueType, Link>>(key, value);
 		node->container.first = key;
 		node->container.second = value;
 		node->left = nullptr_node;
 		node->right = nullptr_node;
 
-		Shared_ptr<Node<KeyType, ValueType>> y;
+		NodePtr y;
 		y = nullptr;
-		Shared_ptr<Node<KeyType, ValueType>> x = this->root;
+		NodePtr x = this->root;
 
 		while (x != nullptr_node) {
 			y = x;
@@ -544,13 +438,13 @@ public:
 		return searchTree(key);
 	}
 
-	Shared_ptr<Node<KeyType, ValueType>> getRoot() {
+	NodePtr getRoot() {
 		return this->root;
 	}
 
-	Shared_ptr<Node<KeyType, ValueType>> next(Shared_ptr<Node<KeyType, ValueType>> node)
+	NodePtr next(NodePtr node)
 	{
-		Shared_ptr<Node<KeyType, ValueType>> tmp = node->right;
+		NodePtr tmp = node->right;
 
 		if (tmp) {
 			while (tmp->left) tmp = tmp->left;
@@ -566,12 +460,12 @@ public:
 	class iterator
 	{
 	private:
-		Shared_ptr<Node<KeyType, ValueType>> iter;
-		Shared_ptr<Node<KeyType, ValueType>> root_iter;
+		NodePtr iter;
+		NodePtr root_iter;
 	public:
 		std::pair<KeyType, ValueType> pair;
 		iterator() {}
-		iterator(Shared_ptr<Node<KeyType, ValueType>> root) :iter(root) {
+		iterator(NodePtr root) :iter(root) {
 			pair.first = root->container.first;
 			pair.second = root->container.second;
 		}
@@ -589,13 +483,13 @@ public:
 
 	iterator begin()
 	{
-		Shared_ptr<Node<KeyType, ValueType>> current = this->root;
+		NodePtr current = this->root;
 
 		return iterator(minimum(current));
 	}
 	iterator end()
 	{
-		Shared_ptr<Node<KeyType, ValueType>> current = this->root;
+		NodePtr current = this->root;
 		return iterator(maximum(current));
 	}
 
@@ -5,153 +5,46 @@
 #include <algorithm>
 #include <queue>
 #include <vector>
+#include <chrono>
+#include <random>
+#include "../SmartPointers/SharedPtr.h"
 
-template<typename T>
-class Shared_ptr {
-public:
-	using element_type = T;
-
-	Shared_ptr() : ptr_(nullptr), ref_count(nullptr) {}
-
-	explicit Shared_ptr(T* p) : ptr_(p), ref_count(new int(1)) {}
-
-	Shared_ptr(const Shared_ptr<T>& other) : ptr_(other.ptr_), ref_count(other.ref_count) {
-		if (ref_count) {
-			++(*ref_count);
-		}
-	}
-
-	Shared_ptr(Shared_ptr<T>&& other) : ptr_(nullptr), ref_count(nullptr) {
-		swap(other);
-	}
-
-	Shared_ptr& operator=(const Shared_ptr& sp) noexcept {
-		if (ptr_ != sp.ptr_) {
-			release();
-			ptr_ = sp.ptr_;
-			ref_count = sp.ref_count;
-			if (ref_count) {
-				++(*ref_count);
-			}
-		}
-		return *this;
-	}
-
-	Shared_ptr& operator=(std::nullptr_t)
-	{
-		reset();
-		return *this;
-	}
-
-	Shared_ptr& operator=(Shared_ptr&& sp) noexcept {
-		if (ptr_ != sp.ptr_) {
-			release();
-			std::swap(ptr_, sp.ptr_);
-			std::swap(ref_count, sp.ref_count);
-		}
-		return *this;
-	}
-
-	template <class Other>
-	Shared_ptr& operator=(const Shared_ptr<Other>& sp) noexcept {
-		release();
-		ptr_ = sp.ptr_;
-		ref_count = sp.ref_count;
-		if (ref_count) {
-			++(*ref_count);
-		}
-		return *this;
-	}
-
-	template <class Other>
-	Shared_ptr& operator=(Shared_ptr<Other>&& sp) noexcept {
-		release();
-		std::swap(ptr_, sp.ptr_);
-		std::swap(ref_count, sp.ref_count);
-		return *this;
-	}
-
-	~Shared_ptr() {
-		release();
-	}
-
-	T* get() const noexcept {
-		return ptr_;
-	}
-
-	void reset(T* p = nullptr) {
-		release();
-		ptr_ = p;
-		ref_count = new int(1);
-	}
-
-	void swap(Shared_ptr<T>& other) {
-		std::swap(ptr_, other.ptr_);
-		std::swap(ref_count, other.ref_count);
-	}
+// What a tree node needs for each kind of link: a base holding the count
+// (empty for Shared_ptr) and a way to create the node
+template<template<typename...> class Link>
+struct LinkTraits;
 
+template<>
+struct LinkTraits<Shared_ptr> {
+	struct Base {};
 
-	explicit operator bool() const noexcept {
-		return ptr_ != nullptr;
-	}
-
-
-
-	T* operator->() const {
-		return ptr_;
-	}
-
-	bool operator==(std::nullptr_t) const noexcept {
-		return ptr_ == nullptr;
-	}
-
-	bool operator==(const Shared_ptr& ptr) const noexcept {
-		return ptr_ == ptr.ptr_;
+	template<typename T, typename... Args>
+	static Shared_ptr<T> make(Args&&... args) {
+		return Make_shared<T>(std::forward<Args>(args)...);
 	}
+};
 
-	bool operator!=(const Shared_ptr& ptr) const noexcept {
-		return ptr_ != ptr.ptr_;
-	}
+template<>
+struct LinkTraits<IntrusivePtr> {
+	using Base = RefCounted<SingleThreaded>;
 
-	friend std::ostream& operator<<(std::ostream& os, const Shared_ptr<T>& p) {
-		os << p.ptr_;
-		return os;
+	template<typename T, typename... Args>
+	static IntrusivePtr<T> make(Args&&... args) {
+		return MakeIntrusive<T>(std::forward<Args>(args)...);
 	}
-
-	void release() {
-		if (ref_count) {
-			--(*ref_count);
-			if (*ref_count == 0) {
-				delete ptr_;
-				delete ref_count;
-			}
-			ptr_ = nullptr;
-			ref_count = nullptr;
-		}
-	}
-
-private:
-	T* ptr_;
-	int* ref_count;
 };
 
-template<typename T, typename... Args>
-Shared_ptr<T> MakeShared(Args&&... args) {
-	return Shared_ptr<T>(new T(std::forward<Args>(args)...));
-}
-
-
 typedef bool color_type;
-template<class KeyType>
-struct Node {
+template<class KeyType, template<typename...> class Link = Shared_ptr>
+struct Node : LinkTraits<Link>::Base {
 
 	std::pair<KeyType, char> container;
 
-	Shared_ptr<Node<KeyType>> parent;
+	Link<Node> parent;
 
-	Shared_ptr<Node<KeyType>> left;
+	Link<Node> left;
 
-	Shared_ptr<Node<KeyType>> right;
+	Link<Node> right;
 
 	color_type color; // 1 -> Red, 0 -> Black
 	Node(KeyType key)
@@ -173,14 +66,17 @@ struct Node {
 
 };
 
-template<class KeyType>
+template<class KeyType, template<typename...> class Link = Shared_ptr>
 class Set {
+public:
+	using NodePtr = Link<Node<KeyType, Link>>;
+
 private:
-	Shared_ptr<Node<KeyType>> root;
+	NodePtr root;
 
-	Shared_ptr<Node<KeyType>> nullptr_node;
+	NodePtr nullptr_node;
 
-	KeyType searchTreeHelper(Shared_ptr<Node<KeyType>> node, KeyType key) {
+	KeyType searchTreeHelper(NodePtr node, KeyType key) {
 		if (node == nullptr_node || key == node->container.first) {
 			return  node->container.first;
 		}
@@ -192,8 +88,8 @@ private:
 	}
 
 
-	void getRotationColorChange(Shared_ptr<Node<KeyType>> node) {
-		Shared_ptr<Node<KeyType>> uncle_node;
+	void getRotationColorChange(NodePtr node) {
+		NodePtr uncle_node;
 		while (node->parent->color == true) {
 			if (node->parent == node->parent->parent->right) {
 				uncle_node = node->parent->parent->left; // uncle
@@ -245,8 +141,8 @@ private:
 		root->color = false;
 	}
 
-	void deleteFix(Shared_ptr<Node<KeyType>> x) {
-		Shared_ptr<Node<KeyType>> s;
+	void deleteFix(NodePtr x) {
+		NodePtr s;
 		while (x != root && x->color == 0) {
 			if (x == x->parent->left) {
 				s = x->parent->right;
@@ -308,7 +204,7 @@ private:
 		x->color = 0;
 	}
 
-	void rbTransplant(Shared_ptr<Node<KeyType>> u, Shared_ptr<Node<KeyType>> v) {
+	void rbTransplant(NodePtr u, NodePtr v) {
 		if (u->parent == nullptr) {
 			root = v;
 		}
@@ -321,9 +217,9 @@ private:
 		v->parent = u->parent;
 	}
 
-	void deleteNodeHelper(Shared_ptr<Node<KeyType>> node, KeyType key) {
-		Shared_ptr<Node<KeyType>>  z = nullptr_node;
-		Shared_ptr<Node<KeyType>>  x, y;
+	void deleteNodeHelper(NodePtr node, KeyType key) {
+		NodePtr  z = nullptr_node;
+		NodePtr  x, y;
 		while (node != nullptr_node) {
 			if (node->container.first == key) {
 				z = node;
@@ -376,7 +272,7 @@ private:
 		}
 	}
 
-	std::vector<std::string>& inOrderHelper(Shared_ptr<Node<KeyType>> node) {
+	std::vector<std::string>& inOrderHelper(NodePtr node) {
 		if (node != nullptr_node) {
 			inOrderHelper(node->left);
 			vec.push_back(node->container.first);
@@ -389,7 +285,7 @@ private:
 public:
 	std::vector<std::string> vec;
 	Set() {
-		nullptr_node = Shared_ptr<Node<KeyType>>(new Node<KeyType>());
+		nullptr_node = LinkTraits<Link>::template make<Node<KeyType, Link>>();
 		nullptr_node->color = false;
 		nullptr_node->left = nullptr;
 		nullptr_node->right = nullptr;
@@ -401,26 +297,26 @@ public:
 		return vec;
 	}
 
-	Shared_ptr<Node<KeyType>> minimum(Shared_ptr<Node<KeyType>> node) {
+	NodePtr minimum(NodePtr node) {
 		while (node->left != nullptr_node) {
 			node = node->left;
 		}
 		return node;
 	}
 
-	Shared_ptr<Node<KeyType>> maximum(Shared_ptr<Node<KeyType>> node) {
+	NodePtr maximum(NodePtr node) {
 		while (node->right != nullptr_node) {
 			node = node->right;
 		}
 		return node;
 	}
 
-	Shared_ptr<Node<KeyType>> successor(Shared_ptr<Node<KeyType>> x) {
+	NodePtr successor(NodePtr x) {
 		if (x->right != nullptr_node) {
 			return minimum(x->right);
 		}
 
-		Shared_ptr<Node<KeyType>> y = x->parent;
+		NodePtr y = x->parent;
 		while (y != nullptr_node && x == y->right) {
 			x = y;
 			y = y->parent;
@@ -428,12 +324,12 @@ public:
 		return y;
 	}
 
-	Shared_ptr<Node<KeyType>> predecessor(Shared_ptr<Node<KeyType>> x) {
+	NodePtr predecessor(NodePtr x) {
 		if (x->left != nullptr_node) {
 			return maximum(x->left);
 		}
 
-		Shared_ptr<Node<KeyType>> y = x->parent;
+		NodePtr y = x->parent;
 		while (y != nullptr_node && x == y->left) {
 			x = y;
 			y = y->parent;
@@ -443,8 +339,8 @@ public:
 	}
 
 
-	void leftRotate(Shared_ptr<Node<KeyType>> x) {
-		Shared_ptr<Node<KeyType>> y = x->right;
+	void leftRotate(NodePtr x) {
+		NodePtr y = x->right;
 		x->right = y->left;
 		if (y->left != nullptr_node) {
 			y->left->parent = x;
@@ -463,8 +359,8 @@ public:
 		x->parent = y;
 	}
 
-	void rightRotate(Shared_ptr<Node<KeyType>> x) {
-		Shared_ptr<Node<KeyType>> y = x->left;
+	void rightRotate(NodePtr x) {
+		NodePtr y = x->left;
 		x->left = y->right;
 		if (y->right != nullptr_node) {
 			y->right->parent = x;
@@ -485,15 +381,15 @@ public:
 
 	void insert(KeyType key) {
 
-		Shared_ptr<Node<KeyType>> node = Shared_ptr<Node<KeyType>>(new Node<KeyType>(key));
+		NodePtr node = LinkTraits<Link>::template make<Node<KeyType, Link>>(key);
 		node->container.first = key;
 
 		node->left = nullptr_node;
 		node->right = nullptr_node;
 
-		Shared_ptr<Node<KeyType>> y;
+		NodePtr y;
 		y = nullptr;
-		Shared_ptr<Node<KeyType>> x = this->root;
+		NodePtr x = this->root;
 
 		while (x != nullptr_node) {
 			y = x;
@@ -544,13 +440,13 @@ public:
 		return searchTree(key);
 	}
 
-	Shared_ptr<Node<KeyType>> getRoot() {
+	NodePtr getRoot() {
 		return this->root;
 	}
 
-	Shared_ptr<Node<KeyType>> next(Shared_ptr<Node<KeyType>> node)
+	NodePtr next(NodePtr node)
 	{
-		Shared_ptr<Node<KeyType>> tmp = node->right;
+		NodePtr tmp = node->right;
 
 		if (tmp) {
 			while (tmp->left) tmp = tmp->left;
@@ -566,12 +462,12 @@ public:
 	class iterator
 	{
 	private:
-		Shared_ptr<Node<KeyType>> iter;
-		Shared_ptr<Node<KeyType>> root_iter;
+		NodePtr iter;
+		NodePtr root_iter;
 	public:
 		std::pair<KeyType, char> pair;
 		iterator() {}
-		iterator(Shared_ptr<Node<KeyType>> root) :iter(root) {
+		iterator(NodePtr root) :iter(root) {
 			pair.first = root->container.first;
 		}
 
@@ -588,22 +484,66 @@ public:
 
 	iterator begin()
 	{
-		Shared_ptr<Node<KeyType>> current = this->root;
+		NodePtr current = this->root;
 
 		return iterator(minimum(current));
 	}
 	iterator end()
 	{
-		Shared_ptr<Node<KeyType>> current = this->root;
+		NodePtr current = this->root;
 		return iterator(maximum(current));
 	}
 	//NOT FINISHED
 
 };
 
+template<typename F>
+double measure_ms(F&& f) {
+	auto start = std::chrono::steady_clock::now();
+	f();
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Tree links cost a count update on every copy made while walking the tree;
+// compare the control block of Shared_ptr with the count kept in the node
+template<template<typename...> class Link>
+void bench_tree(const char* name, const std::vector<int>& keys) {
+	Set<int, Link> set;
+	long long found = 0;
+	double insert = measure_ms([&] {
+		for (int key : keys) {
+			set.insert(key);
+		}
+	});
+	double search = measure_ms([&] {
+		for (int key : keys) {
+			found += set.searchTree(key) == key;
+		}
+	});
+	std::cout << name << ": insert " << insert << " ms, search " << search
+		<< " ms (" << found << " found)\n";
+}
+
+void bench_links() {
+	const int count = 200000;
+	std::vector<int> keys(count);
+	std::mt19937 rng(42);
+	for (int& key : keys) {
+		key = static_cast<int>(rng());
+	}
+	bench_tree<Shared_ptr>("Shared_ptr links  ", keys);
+	bench_tree<IntrusivePtr>("IntrusivePtr links", keys);
+}
+
 int main()
 {
 	Set<int> f;
 	f.insert(5);
-	std::cout << f.searchTree(6);
+	std::cout << f.searchTree(6) << "\n";
+
+	Set<int, IntrusivePtr> g;
+	g.insert(5);
+	std::cout << g.searchTree(5) << "\n";
+
+	bench_links();
 }
\ No newline at end of file
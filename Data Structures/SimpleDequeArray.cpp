@@ -3,25 +3,43 @@
 #include <string>
 #include <vector>
 #include <algorithm>
+#include <deque>
+#include <chrono>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <queue>
+#include <functional>
+#include <cstdio>
+#include <cstdint>
+#include <iterator>
+#include <random>
 
 #include <type_traits>
-#include <iostream>
+#include <memory>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#ifndef _WIN32
+#include <sys/types.h>
+#endif
+#include "../SmartPointers/CompressedPair.h"
 
 template <class T, class Del = std::default_delete<T>>
 class UniquePtr {
 public:
 	// Constructors
-	UniquePtr() noexcept : ptr_(nullptr), deleter_(Del()) {}
-	UniquePtr(nullptr_t) noexcept : ptr_(nullptr), deleter_(Del()) {}
-	explicit UniquePtr(T* ptr) noexcept : ptr_(ptr), deleter_(Del()) {}
-	UniquePtr(T* ptr, const Del& deleter) noexcept : ptr_(ptr), deleter_(deleter) {}
-	UniquePtr(T* ptr, Del&& deleter) noexcept : ptr_(ptr), deleter_(std::move(deleter)) {}
-	UniquePtr(UniquePtr&& other) noexcept : ptr_(other.release()), deleter_(std::move(other.deleter_)) {}
+	UniquePtr() noexcept : pair_(nullptr, Del()) {}
+	UniquePtr(nullptr_t) noexcept : pair_(nullptr, Del()) {}
+	explicit UniquePtr(T* ptr) noexcept : pair_(ptr, Del()) {}
+	UniquePtr(T* ptr, const Del& deleter) noexcept : pair_(ptr, deleter) {}
+	UniquePtr(T* ptr, Del&& deleter) noexcept : pair_(ptr, std::move(deleter)) {}
+	UniquePtr(UniquePtr&& other) noexcept : pair_(other.release(), std::move(other.pair_.second())) {}
 
 	// Move assignment operator
 	UniquePtr& operator=(UniquePtr&& other) noexcept {
 		reset(other.release());
-		deleter_ = std::move(other.deleter_);
+		pair_.second() = std::move(other.pair_.second());
 		return *this;
 	}
 
@@ -36,60 +54,59 @@ public:
 
 	// Release ownership
 	T* release() noexcept {
-		T* ptr = ptr_;
-		ptr_ = nullptr;
+		T* ptr = pair_.first;
+		pair_.first = nullptr;
 		return ptr;
 	}
 
 	// Reset pointer and deleter
 	void reset(T* ptr = nullptr) noexcept {
-		if (ptr_ != ptr) {
-			deleter_(ptr_);
-			ptr_ = ptr;
+		if (pair_.first != ptr) {
+			pair_.second()(pair_.first);
+			pair_.first = ptr;
 		}
 	}
 
 	// Swap pointers and deleters
 	void swap(UniquePtr& other) noexcept {
-		std::swap(ptr_, other.ptr_);
-		std::swap(deleter_, other.deleter_);
+		std::swap(pair_.first, other.pair_.first);
+		std::swap(pair_.second(), other.pair_.second());
 	}
 
 	// Accessor
 	T* get() const noexcept {
-		return ptr_;
+		return pair_.first;
 	}
 
 	Del& get_deleter() {
-		return deleter_;
+		return pair_.second();
 	}
 
 	const Del& get_deleter() const {
-		return deleter_;
+		return pair_.second();
 	}
 
 	// Dereference operator
 	T& operator*() const noexcept {
-		return *ptr_;
+		return *pair_.first;
 	}
 
 	T* operator->() const noexcept {
-		return ptr_;
+		return pair_.first;
 	}
 
 	friend std::ostream& operator<<(std::ostream& os, const UniquePtr<T>& p) {
-		os << p.ptr_;
+		os << p.pair_.first;
 		return os;
 	}
 
 	// Boolean conversion operator
 	explicit operator bool() const noexcept {
-		return ptr_ != nullptr;
+		return pair_.first != nullptr;
 	}
 
 private:
-	T* ptr_;
-	Del deleter_;
+	CompressedPair<Del, T*> pair_;
 };
 
 template <class T, class D>
@@ -100,25 +117,25 @@ public:
 	using deleter_type = D;
 
 	// Constructors
-	constexpr UniquePtr() noexcept : ptr_(nullptr), deleter_(deleter_type()) {}
+	constexpr UniquePtr() noexcept : pair_(nullptr, deleter_type()) {}
 
 	template <class U>
-	explicit UniquePtr(U p) noexcept : ptr_(p), deleter_(deleter_type()) {}
+	explicit UniquePtr(U p) noexcept : pair_(p, deleter_type()) {}
 
 	template <class U>
 	UniquePtr(U p, typename std::enable_if<std::is_convertible<U, pointer>::value, deleter_type>::type d) noexcept
-		: ptr_(p), deleter_(d) {}
+		: pair_(p, d) {}
 
 	template <class U>
 	UniquePtr(U p, typename std::enable_if<std::is_convertible<U, pointer>::value, deleter_type&&>::type d) noexcept
-		: ptr_(p), deleter_(std::move(d)) {}
+		: pair_(p, std::move(d)) {}
 
-	UniquePtr(UniquePtr&& u) noexcept : ptr_(u.ptr_), deleter_(std::move(u.deleter_)) {
-		u.ptr_ = nullptr;
+	UniquePtr(UniquePtr&& u) noexcept : pair_(u.pair_.first, std::move(u.pair_.second())) {
+		u.pair_.first = nullptr;
 	}
 
 	template <class U, class E>
-	UniquePtr(UniquePtr<U, E>&& u) noexcept : ptr_(u.release()), deleter_(std::move(u.get_deleter())) {}
+	UniquePtr(UniquePtr<U, E>&& u) noexcept : pair_(u.release(), std::move(u.get_deleter())) {}
 
 	// Destructor
 	~UniquePtr() {
@@ -128,14 +145,14 @@ public:
 	// Move assignment operators
 	UniquePtr& operator=(UniquePtr&& u) noexcept {
 		reset(u.release());
-		deleter_ = std::move(u.deleter_);
+		pair_.second() = std::move(u.pair_.second());
 		return *this;
 	}
 
 	template <class U, class E>
 	UniquePtr& operator=(UniquePtr<U, E>&& u) noexcept {
 		reset(u.release());
-		deleter_ = std::move(u.get_deleter());
+		pair_.second() = std::move(u.get_deleter());
 		return *this;
 	}
 
@@ -146,38 +163,38 @@ public:
 
 	// Element access
 	T& operator[](size_t i) const {
-		return ptr_[i];
+		return pair_.first[i];
 	}
 
 	// Accessors
 	pointer get() const noexcept {
-		return ptr_;
+		return pair_.first;
 	}
 
 	deleter_type& get_deleter() noexcept {
-		return deleter_;
+		return pair_.second();
 	}
 
 	const deleter_type& get_deleter() const noexcept {
-		return deleter_;
+		return pair_.second();
 	}
 
 	explicit operator bool() const noexcept {
-		return ptr_ != nullptr;
+		return pair_.first != nullptr;
 	}
 
 	// Release ownership
 	pointer release() noexcept {
-		pointer p = ptr_;
-		ptr_ = nullptr;
+		pointer p = pair_.first;
+		pair_.first = nullptr;
 		return p;
 	}
 
 	// Reset pointer and deleter
 	void reset(pointer p = pointer()) noexcept {
-		if (ptr_ != p) {
-			deleter_(ptr_);
-			ptr_ = p;
+		if (pair_.first != p) {
+			pair_.second()(pair_.first);
+			pair_.first = p;
 		}
 	}
 
@@ -190,15 +207,17 @@ public:
 
 	// Swap pointers and deleters
 	void swap(UniquePtr& u) noexcept {
-		std::swap(ptr_, u.ptr_);
-		std::swap(deleter_, u.deleter_);
+		std::swap(pair_.first, u.pair_.first);
+		std::swap(pair_.second(), u.pair_.second());
 	}
 
 private:
-	pointer ptr_;
-	deleter_type deleter_;
+	CompressedPair<deleter_type, pointer> pair_;
 };
 
+static_assert(sizeof(UniquePtr<int>) == sizeof(int*), "a stateless deleter must cost no space");
+static_assert(sizeof(UniquePtr<int[]>) == sizeof(int*), "a stateless deleter must cost no space");
+
 // Non-member swap function
 template <class T, class Del>
 void Swap(UniquePtr<T, Del>& lhs, UniquePtr<T, Del>& rhs) noexcept {
@@ -231,6 +250,12 @@ MakeUnique(int size)
 	return UniquePtr<T>(new type[size]);
 };
 
+struct free_deleter {
+	void operator()(void* p) const { free(p); }
+};
+
+static_assert(sizeof(UniquePtr<int[], free_deleter>) == sizeof(int*), "free_deleter must cost no space");
+
 template <class X>
 class Deque {
 
@@ -241,44 +266,169 @@ private:
 	// Stores the backIndex
 	int backIndex;
 
-	// Stores the array
-	UniquePtr<X[]> arr;
+	// Stores the array, raw storage in which only the
+	// slots between frontIndex and backIndex are constructed
+	UniquePtr<X[], free_deleter> arr;
 
 	// Stores the size of deque
 	int sizeVar;
 
-	// Stores the size of array
+	// Stores the size of array, always a power of
+	// two so indices wrap with & (capacityVar - 1)
 	int capacityVar = 4;
 
+	void reallocate(int newCapacity);
+	static int round_up(int n);
+	static X* allocate(int n);
+	static void relocate(X* dst, X* src, int n);
+	static void destroy(X* first, int n);
+
 public:
 	// Deque class constructor
 	Deque()
 	{
-		arr = MakeUnique<X[]>(capacityVar);
+		arr = UniquePtr<X[], free_deleter>(allocate(capacityVar));
 		frontIndex = backIndex = -1;
 		sizeVar = 0;
 	}
 
+	~Deque() { clear(); }
+
 	// Function methods
 	bool empty();
 	bool full();
-	void push_back(X x);
-	void push_front(X x);
+	void push_back(const X& x);
+	void push_back(X&& x);
+	void push_front(const X& x);
+	void push_front(X&& x);
+	template <class ...Args>
+	X& emplace_back(Args&& ...args);
+	template <class ...Args>
+	X& emplace_front(Args&& ...args);
 	void pop_front();
 	void pop_back();
 	X front();
 	X back();
 	int capacity();
 	int size();
+	void reserve(int n);
+	void shrink_to_fit();
 
 	X& operator[](int index)
 	{
-		return arr[index];
+		return arr[(frontIndex + index) & (capacityVar - 1)];
 	}
 
-	void clear() { arr.reset(); }
+	void clear();
 };
 
+// Function to allocate uninitialized
+// storage for n elements
+template <class X>
+X* Deque<X>::allocate(int n)
+{
+	return static_cast<X*>(malloc(sizeof(X) * n));
+}
+
+// Function to move n elements into raw storage.
+// Copies instead when the move constructor may throw,
+// so a failed relocation leaves the source intact
+template <class X>
+void Deque<X>::relocate(X* dst, X* src, int n)
+{
+	if constexpr (std::is_trivially_copyable_v<X>) {
+		if (n > 0)
+			memcpy(dst, src, sizeof(X) * n);
+	}
+	else {
+		int i = 0;
+		try {
+			for (; i < n; ++i)
+				new (dst + i) X(std::move_if_noexcept(src[i]));
+		}
+		catch (...) {
+			destroy(dst, i);
+			throw;
+		}
+	}
+}
+
+// Function to destroy n elements
+template <class X>
+void Deque<X>::destroy(X* first, int n)
+{
+	if constexpr (!std::is_trivially_destructible_v<X>) {
+		for (int i = 0; i < n; ++i)
+			first[i].~X();
+	}
+}
+
+// Function to round n up to a power of two
+template <class X>
+int Deque<X>::round_up(int n)
+{
+	int p = 1;
+	while (p < n)
+		p <<= 1;
+	return p;
+}
+
+// Function to move the elements into an array
+// of newCapacity slots. They occupy at most two
+// runs of the old array: [frontIndex, capacityVar)
+// and [0, backIndex], so this is two bulk moves
+template <class X>
+void Deque<X>::reallocate(int newCapacity)
+{
+	UniquePtr<X[], free_deleter> temp(allocate(newCapacity));
+
+	if (empty()) {
+		arr = std::move(temp);
+		capacityVar = newCapacity;
+		return;
+	}
+
+	int first = capacityVar - frontIndex;
+	if (first > sizeVar)
+		first = sizeVar;
+
+	relocate(temp.get(), arr.get() + frontIndex, first);
+	try {
+		relocate(temp.get() + first, arr.get(), sizeVar - first);
+	}
+	catch (...) {
+		destroy(temp.get(), first);
+		throw;
+	}
+
+	destroy(arr.get() + frontIndex, first);
+	destroy(arr.get(), sizeVar - first);
+
+	arr = std::move(temp);
+	capacityVar = newCapacity;
+	frontIndex = 0;
+	backIndex = sizeVar - 1;
+}
+
+// Function to make room for at least n
+// elements without further reallocation
+template <class X>
+void Deque<X>::reserve(int n)
+{
+	if (n > capacityVar)
+		reallocate(round_up(n));
+}
+
+// Function to release unused capacity, keeping
+// the smallest power of two that fits the elements
+template <class X>
+void Deque<X>::shrink_to_fit()
+{
+	int newCapacity = round_up(sizeVar);
+	if (newCapacity < capacityVar)
+		reallocate(newCapacity);
+}
+
 // Function to find the capacity of the deque
 template <class X>
 int Deque<X>::capacity()
@@ -335,105 +485,93 @@ X Deque<X>::back()
 	return arr[backIndex];
 }
 
-// Function to insert the element
-// to the back of the deque
+// Function to construct the element
+// in place at the back of the deque
 template <class X>
-void Deque<X>::push_back(X x)
+template <class ...Args>
+X& Deque<X>::emplace_back(Args&& ...args)
 {
-	if (full()) {
+	int index;
 
-		// If the deque is full, then
-		// double the capacity
-		capacityVar = capacityVar * 2;
-
-		// Initialize new array of
-		// double size
-		UniquePtr<X[]> temp = MakeUnique<X[]>(capacityVar);
-
-		// Copy the elements of the
-		// previous array
-		int i = frontIndex;
-		int j = 0;
-		while (i != backIndex) {
-			temp[j] = arr[i];
-			i = (i + 1) % sizeVar;
-			j++;
-		}
-		temp[j] = arr[i];
-
-		frontIndex = 0;
-		backIndex = sizeVar - 1;
+	if (full()) {
 
-		// Deallocate the memory
-		// of previous array
-		arr.reset();
-		arr = std::move(temp);
+		// Build the element before growing, the
+		// arguments may refer into the old array
+		X x(std::forward<Args>(args)...);
+		reallocate(capacityVar * 2);
+		index = sizeVar;
+		new (&arr[index]) X(std::move(x));
 	}
+	else {
 
-	// If size is zero
-	if (empty()) {
-		frontIndex = backIndex = 0;
-		arr[backIndex] = x;
-		sizeVar++;
-		return;
+		// Increment back index cyclically
+		index = empty() ? 0 : (backIndex + 1) & (capacityVar - 1);
+		new (&arr[index]) X(std::forward<Args>(args)...);
+
+		if (empty())
+			frontIndex = index;
 	}
 
-	// Increment back index cyclically
-	backIndex = (backIndex + 1) % capacityVar;
-	arr[backIndex] = x;
+	backIndex = index;
 	sizeVar++;
-	return;
+	return arr[index];
 }
 
-// Function to insert the element
-// to the front of the deque
+// Function to construct the element
+// in place at the front of the deque
 template <class X>
-void Deque<X>::push_front(X x)
+template <class ...Args>
+X& Deque<X>::emplace_front(Args&& ...args)
 {
-	if (full()) {
-
-		// If the deque is full, then
-		// double the capacity
-		capacityVar = capacityVar * 2;
-
-		// Initialize new array of
-		// double size
-		X* temp = new X[capacityVar];
-
-		// Copy the elements of the
-		// previous array
-		int i = frontIndex;
-		int j = 0;
-		while (i != backIndex) {
-			temp[j] = arr[i];
-			i = (i + 1) % sizeVar;
-			j++;
-		}
-		temp[j] = arr[i];
+	int index;
 
-		frontIndex = 0;
-		backIndex = sizeVar - 1;
-
-		// Deallocate the memory
-		// of previous array
-		delete[] arr;
-		arr = temp;
+	if (full()) {
+		X x(std::forward<Args>(args)...);
+		reallocate(capacityVar * 2);
+		index = capacityVar - 1;
+		new (&arr[index]) X(std::move(x));
 	}
+	else {
 
-	// If size is zero
-	if (empty()) {
-		frontIndex = backIndex = 0;
-		arr[backIndex] = x;
-		sizeVar++;
-		return;
+		// Decrement front index cyclically
+		index = empty() ? 0 : (frontIndex - 1) & (capacityVar - 1);
+		new (&arr[index]) X(std::forward<Args>(args)...);
+
+		if (empty())
+			backIndex = index;
 	}
 
-	// Decrement front index cyclically
-	frontIndex
-		= (frontIndex - 1 + capacityVar) % capacityVar;
-	arr[frontIndex] = x;
+	frontIndex = index;
 	sizeVar++;
-	return;
+	return arr[index];
+}
+
+// Function to insert the element
+// to the back of the deque
+template <class X>
+void Deque<X>::push_back(const X& x)
+{
+	emplace_back(x);
+}
+
+template <class X>
+void Deque<X>::push_back(X&& x)
+{
+	emplace_back(std::move(x));
+}
+
+// Function to insert the element
+// to the front of the deque
+template <class X>
+void Deque<X>::push_front(const X& x)
+{
+	emplace_front(x);
+}
+
+template <class X>
+void Deque<X>::push_front(X&& x)
+{
+	emplace_front(std::move(x));
 }
 
 // Function to delete the element
@@ -447,6 +585,8 @@ void Deque<X>::pop_front()
 		abort();
 	}
 
+	arr[frontIndex].~X();
+
 	// If there is only one character
 	if (frontIndex == backIndex) {
 
@@ -458,7 +598,7 @@ void Deque<X>::pop_front()
 	}
 
 	// Increment frontIndex cyclically
-	frontIndex = (frontIndex + 1) % capacityVar;
+	frontIndex = (frontIndex + 1) & (capacityVar - 1);
 	sizeVar--;
 	return;
 }
@@ -474,6 +614,8 @@ void Deque<X>::pop_back()
 		abort();
 	}
 
+	arr[backIndex].~X();
+
 	// If there is only one character
 	if (frontIndex == backIndex) {
 
@@ -485,12 +627,500 @@ void Deque<X>::pop_back()
 	}
 
 	// Decrement backIndex cyclically
-	backIndex = (backIndex - 1 + capacityVar) % capacityVar;
+	backIndex = (backIndex - 1) & (capacityVar - 1);
 	sizeVar--;
 	return;
 }
 
+// Function to delete all elements,
+// the array is kept for reuse
+template <class X>
+void Deque<X>::clear()
+{
+	if (empty())
+		return;
+
+	int first = capacityVar - frontIndex;
+	if (first > sizeVar)
+		first = sizeVar;
+
+	destroy(arr.get() + frontIndex, first);
+	destroy(arr.get(), sizeVar - first);
 
+	frontIndex = backIndex = -1;
+	sizeVar = 0;
+}
+
+
+
+// Bounded single-producer/single-consumer ring on the same raw
+// storage as Deque. Exactly one thread may push and one may pop.
+// Indices only grow, the slot of an index is index & mask.
+template <class X>
+class SpscRing {
+
+private:
+	static constexpr int cacheLine = 64;
+
+	// Consumer side: the index it pops next and
+	// the last tail it has seen
+	alignas(cacheLine) std::atomic<size_t> head{ 0 };
+	size_t cachedTail = 0;
+
+	// Producer side: the index it pushes next and
+	// the last head it has seen
+	alignas(cacheLine) std::atomic<size_t> tail{ 0 };
+	size_t cachedHead = 0;
+
+	// Read-only after construction
+	alignas(cacheLine) UniquePtr<X[], free_deleter> arr;
+	size_t capacityVar;
+	size_t mask;
+
+	// Function to refresh the cached head when
+	// the ring looks like it has less than n free slots
+	size_t free_slots(size_t t, size_t n)
+	{
+		size_t free = capacityVar - (t - cachedHead);
+		if (free < n) {
+			cachedHead = head.load(std::memory_order_acquire);
+			free = capacityVar - (t - cachedHead);
+		}
+		return free;
+	}
+
+	size_t ready_slots(size_t h, size_t n)
+	{
+		size_t ready = cachedTail - h;
+		if (ready < n) {
+			cachedTail = tail.load(std::memory_order_acquire);
+			ready = cachedTail - h;
+		}
+		return ready;
+	}
+
+public:
+	// Capacity is rounded up to a power of two
+	explicit SpscRing(size_t capacity)
+	{
+		capacityVar = 1;
+		while (capacityVar < capacity)
+			capacityVar <<= 1;
+		mask = capacityVar - 1;
+		arr = UniquePtr<X[], free_deleter>(static_cast<X*>(malloc(sizeof(X) * capacityVar)));
+	}
+
+	SpscRing(const SpscRing&) = delete;
+	SpscRing& operator=(const SpscRing&) = delete;
+
+	~SpscRing()
+	{
+		size_t t = tail.load(std::memory_order_relaxed);
+		for (size_t h = head.load(std::memory_order_relaxed); h != t; ++h)
+			arr[h & mask].~X();
+	}
+
+	// Producer: returns false when the ring is full
+	template <class ...Args>
+	bool try_emplace(Args&& ...args)
+	{
+		size_t t = tail.load(std::memory_order_relaxed);
+		if (free_slots(t, 1) == 0)
+			return false;
+
+		new (&arr[t & mask]) X(std::forward<Args>(args)...);
+		tail.store(t + 1, std::memory_order_release);
+		return true;
+	}
+
+	bool try_push(const X& x) { return try_emplace(x); }
+	bool try_push(X&& x) { return try_emplace(std::move(x)); }
+
+	// Producer: copies up to n items and publishes them
+	// with a single store, returns how many were pushed
+	size_t push_n(const X* items, size_t n)
+	{
+		size_t t = tail.load(std::memory_order_relaxed);
+		size_t free = free_slots(t, n);
+		if (n > free)
+			n = free;
+
+		for (size_t i = 0; i < n; ++i)
+			new (&arr[(t + i) & mask]) X(items[i]);
+
+		tail.store(t + n, std::memory_order_release);
+		return n;
+	}
+
+	// Consumer: returns false when the ring is empty
+	bool try_pop(X& out)
+	{
+		size_t h = head.load(std::memory_order_relaxed);
+		if (ready_slots(h, 1) == 0)
+			return false;
+
+		X& slot = arr[h & mask];
+		out = std::move(slot);
+		slot.~X();
+		head.store(h + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Consumer: moves up to n items out and releases
+	// their slots with a single store
+	size_t pop_n(X* out, size_t n)
+	{
+		size_t h = head.load(std::memory_order_relaxed);
+		size_t ready = ready_slots(h, n);
+		if (n > ready)
+			n = ready;
+
+		for (size_t i = 0; i < n; ++i) {
+			X& slot = arr[(h + i) & mask];
+			out[i] = std::move(slot);
+			slot.~X();
+		}
+
+		head.store(h + n, std::memory_order_release);
+		return n;
+	}
+
+	// Approximate unless called from the producer or consumer
+	size_t size() const
+	{
+		return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+	}
+
+	size_t capacity() const { return capacityVar; }
+};
+
+
+
+// A spill file that fails to close may have lost buffered writes
+struct file_closer {
+	void operator()(FILE* f) const {
+		if (f && fclose(f) != 0) {
+			std::cout << "Dedup_stream: closing a spill file failed" << std::endl;
+			abort();
+		}
+	}
+};
+
+// Streaming first-occurrence filter. Only 64-bit fingerprints of the
+// values are remembered, so two distinct values whose fingerprints
+// collide (about n^2 / 2^65 for n distinct values) count as duplicates.
+//
+// With a memory budget nothing outgrows it, however long the input. Half
+// of it is the in-memory table; when the table fills, its fingerprints are
+// sorted and spilled to a temporary run file, and the runs are merged
+// (external merge sort) once there are too many. The other half holds a
+// Bloom filter and a sparse index for each run, sized from the budget
+// rather than from the run: while the input is small most new values never
+// touch the disk, and as it grows the filter lets more through and each
+// lookup binary searches further on disk. Values are still judged in a
+// single pass, in input order.
+template <class T, class Hash = std::hash<T>>
+class Dedup_stream
+{
+private:
+	struct Run {
+		UniquePtr<FILE, file_closer> file;
+		size_t count = 0;
+		// Every stride-th fingerprint of the run
+		size_t stride;
+		std::vector<uint64_t> index;
+		std::vector<uint64_t> bloom;
+
+		// expected fingerprints will be written; the filter and the index
+		// together take at most about summaryBytes
+		Run(size_t expected, size_t summaryBytes)
+			: file(tmpfile()),
+			bloom(std::max<size_t>(1, std::min(expected / 6 + 1, summaryBytes / 2 / sizeof(uint64_t))), 0)
+		{
+			if (!file)
+				io_error("creating a spill file");
+			size_t indexEntries = std::max<size_t>(1, summaryBytes / 2 / sizeof(uint64_t));
+			stride = std::max(indexStride, (expected + indexEntries - 1) / indexEntries);
+			index.reserve(expected / stride + 1);
+		}
+
+		// Four probes by double hashing the already mixed fingerprint
+		template <class F>
+		void bloom_bits(uint64_t fp, F&& f) const
+		{
+			uint64_t bits = bloom.size() * 64;
+			uint64_t step = (fp >> 32) | 1;
+			for (int k = 0; k < 4; ++k, fp += step)
+				f((fp % bits) / 64, 1ULL << (fp % 64));
+		}
+	};
+
+	// Smallest index stride, also the most read from disk at once
+	static constexpr size_t indexStride = 64;
+
+	// Runs on disk before they are merged into one
+	size_t maxRuns;
+
+	// Open addressing, 0 marks an empty slot, at most half full
+	std::vector<uint64_t> table;
+	size_t entries = 0;
+	size_t maxEntries;
+	// Filter and index bytes for one run; up to maxRuns + 2 exist while merging
+	size_t runSummaryBytes = 0;
+	size_t distinct = 0;
+	std::vector<Run> runs;
+	Hash hash;
+
+	uint64_t fingerprint(const T& value) const
+	{
+		// splitmix64 finalizer, std::hash may be the identity
+		uint64_t h = hash(value);
+		h ^= h >> 30;
+		h *= 0xbf58476d1ce4e5b9ULL;
+		h ^= h >> 27;
+		h *= 0x94d049bb133111ebULL;
+		h ^= h >> 31;
+		return h ? h : 1;
+	}
+
+	// Returns the slot holding fp or the empty slot where it belongs
+	size_t probe(uint64_t fp) const
+	{
+		size_t mask = table.size() - 1;
+		size_t i = fp & mask;
+		while (table[i] != 0 && table[i] != fp)
+			i = (i + 1) & mask;
+		return i;
+	}
+
+	void grow_table()
+	{
+		std::vector<uint64_t> old(table.size() * 2, 0);
+		old.swap(table);
+		for (uint64_t fp : old)
+			if (fp)
+				table[probe(fp)] = fp;
+	}
+
+	// A run missing fingerprints would let duplicates through, so any
+	// I/O failure on the spill files ends the program
+	static void io_error(const char* what)
+	{
+		std::cout << "Dedup_stream: " << what << " failed" << std::endl;
+		abort();
+	}
+
+	static void put(Run& run, const uint64_t* fps, size_t n)
+	{
+		for (size_t i = 0; i < n; ++i) {
+			if ((run.count + i) % run.stride == 0)
+				run.index.push_back(fps[i]);
+			run.bloom_bits(fps[i], [&](size_t word, uint64_t bit) { run.bloom[word] |= bit; });
+		}
+		if (fwrite(fps, sizeof(uint64_t), n, run.file.get()) != n)
+			io_error("writing a spill file");
+		run.count += n;
+	}
+
+	// Called once the last fingerprint of a run is written
+	static void finish(Run& run)
+	{
+		if (fflush(run.file.get()) != 0)
+			io_error("flushing a spill file");
+	}
+
+	bool run_contains(Run& run, uint64_t fp)
+	{
+		bool maybe = true;
+		run.bloom_bits(fp, [&](size_t word, uint64_t bit) { maybe = maybe && (run.bloom[word] & bit); });
+		if (!maybe)
+			return false;
+
+		auto it = std::upper_bound(run.index.begin(), run.index.end(), fp);
+		if (it == run.index.begin())
+			return false;
+
+		// fp can only be in [lo, hi); narrow that down on disk until it
+		// fits in one read
+		uint64_t lo = ((it - run.index.begin()) - 1) * (uint64_t)run.stride;
+		uint64_t hi = std::min<uint64_t>(lo + run.stride, run.count);
+		while (hi - lo > indexStride) {
+			uint64_t mid = lo + (hi - lo) / 2;
+			uint64_t value;
+			read_at(run, mid, &value, 1);
+			if (value <= fp)
+				lo = mid;
+			else
+				hi = mid;
+		}
+
+		uint64_t buf[indexStride];
+		size_t n = (size_t)(hi - lo);
+		read_at(run, lo, buf, n);
+		return std::binary_search(buf, buf + n, fp);
+	}
+
+	// Reads n fingerprints starting at fingerprint pos. Offsets are 64-bit
+	// on every platform, so runs may be larger than 2 GiB.
+	static void read_at(Run& run, uint64_t pos, uint64_t* buf, size_t n)
+	{
+		uint64_t offset = pos * sizeof(uint64_t);
+#ifdef _WIN32
+		if (_fseeki64(run.file.get(), (long long)offset, SEEK_SET) != 0)
+			io_error("seeking in a spill file");
+#else
+		if (fseeko(run.file.get(), (off_t)offset, SEEK_SET) != 0)
+			io_error("seeking in a spill file");
+#endif
+		if (fread(buf, sizeof(uint64_t), n, run.file.get()) != n)
+			io_error("reading a spill file");
+	}
+
+	void spill_table()
+	{
+		std::vector<uint64_t> sorted;
+		sorted.reserve(entries);
+		for (uint64_t& fp : table) {
+			if (fp)
+				sorted.push_back(fp);
+			fp = 0;
+		}
+		entries = 0;
+		std::sort(sorted.begin(), sorted.end());
+
+		Run run(sorted.size(), runSummaryBytes);
+		put(run, sorted.data(), sorted.size());
+		finish(run);
+		runs.push_back(std::move(run));
+
+		if (runs.size() > maxRuns)
+			merge_runs();
+	}
+
+	// k-way merge of all runs into one; runs never share a fingerprint
+	void merge_runs()
+	{
+		const size_t chunk = 4096;
+		struct Reader {
+			std::vector<uint64_t> buf;
+			size_t pos = 0, left;
+		};
+
+		std::vector<Reader> readers(runs.size());
+		typedef std::pair<uint64_t, size_t> item;
+		std::priority_queue<item, std::vector<item>, std::greater<item>> heap;
+
+		auto refill = [&](size_t r) {
+			Reader& rd = readers[r];
+			size_t n = std::min(chunk, rd.left);
+			rd.buf.resize(n);
+			if (fread(rd.buf.data(), sizeof(uint64_t), n, runs[r].file.get()) != n)
+				io_error("reading a spill file");
+			rd.left -= n;
+			rd.pos = 0;
+			if (n)
+				heap.push(item(rd.buf[0], r));
+		};
+
+		for (size_t r = 0; r < runs.size(); ++r) {
+			if (fseek(runs[r].file.get(), 0, SEEK_SET) != 0)
+				io_error("seeking in a spill file");
+			readers[r].left = runs[r].count;
+			refill(r);
+		}
+
+		size_t total = 0;
+		for (Run& run : runs)
+			total += run.count;
+		Run merged(total, runSummaryBytes);
+
+		std::vector<uint64_t> out;
+		out.reserve(chunk);
+		while (!heap.empty()) {
+			item top = heap.top();
+			heap.pop();
+			out.push_back(top.first);
+			if (out.size() == chunk) {
+				put(merged, out.data(), out.size());
+				out.clear();
+			}
+
+			Reader& rd = readers[top.second];
+			if (++rd.pos < rd.buf.size())
+				heap.push(item(rd.buf[rd.pos], top.second));
+			else
+				refill(top.second);
+		}
+		put(merged, out.data(), out.size());
+		finish(merged);
+
+		runs.clear();
+		runs.push_back(std::move(merged));
+	}
+
+public:
+	// maxBytes == 0 keeps everything in memory; otherwise the table and
+	// the run summaries together stay within about maxBytes and the rest
+	// of the fingerprints go to disk. Runs are merged once there are more
+	// than maxRuns; each run's summary gets (maxBytes - table) / (maxRuns + 2)
+	// bytes, so more runs mean cheaper merges but weaker filters and more
+	// disk reads per lookup.
+	explicit Dedup_stream(size_t maxBytes = 0, size_t maxRuns = 8)
+		: maxRuns(std::max<size_t>(1, maxRuns))
+	{
+		size_t slots = 1024;
+		if (maxBytes) {
+			while (slots * 2 * sizeof(uint64_t) <= maxBytes / 2)
+				slots *= 2;
+			maxEntries = slots / 2;
+			table.assign(slots, 0);
+			size_t tableBytes = slots * sizeof(uint64_t);
+			runSummaryBytes = maxBytes > tableBytes ? (maxBytes - tableBytes) / (this->maxRuns + 2) : 0;
+		}
+		else {
+			maxEntries = 0;
+			table.assign(slots, 0);
+		}
+	}
+
+	// Returns true the first time value is seen
+	bool insert(const T& value)
+	{
+		uint64_t fp = fingerprint(value);
+		size_t i = probe(fp);
+		if (table[i] == fp)
+			return false;
+
+		for (Run& run : runs)
+			if (run_contains(run, fp))
+				return false;
+
+		table[i] = fp;
+		++entries;
+		++distinct;
+
+		if (maxEntries && entries == maxEntries)
+			spill_table();
+		else if (!maxEntries && entries * 2 > table.size())
+			grow_table();
+		return true;
+	}
+
+	// Number of distinct values seen so far
+	size_t size() const { return distinct; }
+
+	size_t spilled_runs() const { return runs.size(); }
+};
+
+// Copies the first occurrence of every value in [first, last) to out
+template <class InputIt, class OutputIt, class T, class Hash>
+OutputIt dedup(InputIt first, InputIt last, OutputIt out, Dedup_stream<T, Hash>& seen)
+{
+	for (; first != last; ++first)
+		if (seen.insert(*first))
+			*out++ = *first;
+	return out;
+}
 
 
 
@@ -504,9 +1134,11 @@ public:
 		deque.push_back(data);
 	}
 
+	// Keeps the first occurrence of every string in
+	// deque order, compacting the deque in place
 	std::string findDublicates(Deque<std::string>& deque)
 	{
-		std::vector<std::string> arr;
+		Dedup_stream<std::string> seen;
 
 		std::string g;
 
@@ -514,26 +1146,21 @@ public:
 
 		int counter = 0;
 
-		while (deque.size() != 0)
+		for (int i = 0; i < size; ++i)
 		{
-			arr.push_back(deque[counter]);
-			counter++;
-		}
-
-		deque.clear();
+			if (!seen.insert(deque[i]))
+				continue;
 
-		std::sort(arr.begin(), arr.end());
+			g += deque[i] + " ";
 
-		arr.erase(std::unique(arr.begin(), arr.end()), arr.end());
-		arr.clear();
-		for (int i = 0; i < arr.size(); ++i)
-		{
-			std::cout << arr[i] << '\n';
+			if (counter != i)
+				deque[counter] = std::move(deque[i]);
+			counter++;
+		}
 
-			g += arr[i] + " ";
+		while (deque.size() != counter)
+			deque.pop_back();
 
-			deque.push_back(arr[i]);
-		}
 		return g;
 	}
 
@@ -549,6 +1176,233 @@ public:
 
 
 };
-int main() {
+template <class F>
+double measure_ms(F&& fn)
+{
+	auto start = std::chrono::steady_clock::now();
+	fn();
+	auto stop = std::chrono::steady_clock::now();
+	return std::chrono::duration<double, std::milli>(stop - start).count();
+}
+
+struct Payload256
+{
+	char bytes[256];
+};
+
+template <class D, class T>
+double fill_ms(int n, const T& value)
+{
+	return measure_ms([&] {
+		D dq;
+		for (int i = 0; i < n; ++i)
+		{
+			T copy = value;
+			if (i % 2) dq.push_back(std::move(copy));
+			else dq.emplace_front(value);
+		}
+	});
+}
+
+void bench_payloads()
+{
+	const int n = 1 << 18;
+	std::string str(48, 'x');
+	Payload256 payload{};
+
+	std::cout << "std::string  Deque " << fill_ms<Deque<std::string>>(n, str)
+		<< " ms, std::deque " << fill_ms<std::deque<std::string>>(n, str) << " ms\n";
+	std::cout << "256-byte     Deque " << fill_ms<Deque<Payload256>>(n, payload)
+		<< " ms, std::deque " << fill_ms<std::deque<Payload256>>(n, payload) << " ms\n";
+}
+
+// Messages per second from one producer thread to one consumer
+// thread, one at a time and in batches of 64
+double spsc_throughput(size_t batch)
+{
+	const size_t n = 1 << 24;
+	SpscRing<size_t> ring(1 << 12);
+	size_t sum = 0;
+
+	double ms = measure_ms([&] {
+		std::thread consumer([&] {
+			std::vector<size_t> buf(batch);
+			for (size_t got = 0; got < n;) {
+				size_t k = batch == 1 ? ring.try_pop(buf[0]) : ring.pop_n(buf.data(), batch);
+				if (k == 0)
+					std::this_thread::yield();
+				for (size_t i = 0; i < k; ++i)
+					sum += buf[i];
+				got += k;
+			}
+		});
+
+		std::vector<size_t> buf(batch);
+		for (size_t sent = 0; sent < n;) {
+			size_t want = std::min(batch, n - sent);
+			for (size_t i = 0; i < want; ++i)
+				buf[i] = sent + i;
+			size_t k = batch == 1 ? ring.try_push(buf[0]) : ring.push_n(buf.data(), want);
+			if (k == 0)
+				std::this_thread::yield();
+			sent += k;
+		}
+		consumer.join();
+	});
+
+	if (sum != n * (n - 1) / 2)
+		std::cout << "checksum mismatch" << '\n';
+	return n / ms / 1000.0;
+}
+
+// The same hand-off through a Deque guarded by a mutex
+double mutex_deque_throughput()
+{
+	const size_t n = 1 << 22;
+	Deque<size_t> dq;
+	std::mutex m;
+	size_t sum = 0;
+
+	double ms = measure_ms([&] {
+		std::thread consumer([&] {
+			for (size_t got = 0; got < n;) {
+				std::lock_guard<std::mutex> lock(m);
+				if (!dq.empty()) {
+					sum += dq.front();
+					dq.pop_front();
+					++got;
+				}
+			}
+		});
+
+		for (size_t i = 0; i < n; ++i) {
+			std::lock_guard<std::mutex> lock(m);
+			dq.push_back(i);
+		}
+		consumer.join();
+	});
+
+	if (sum != n * (n - 1) / 2)
+		std::cout << "checksum mismatch" << '\n';
+	return n / ms / 1000.0;
+}
+
+// Round trip of one message bouncing between two rings
+double spsc_round_trip_ns()
+{
+	const int rounds = 1 << 20;
+	SpscRing<int> ping(64), pong(64);
+
+	double ms = measure_ms([&] {
+		std::thread echo([&] {
+			int v;
+			for (int i = 0; i < rounds; ++i) {
+				while (!ping.try_pop(v)) std::this_thread::yield();
+				while (!pong.try_push(v)) std::this_thread::yield();
+			}
+		});
+
+		int v;
+		for (int i = 0; i < rounds; ++i) {
+			while (!ping.try_push(i)) std::this_thread::yield();
+			while (!pong.try_pop(v)) std::this_thread::yield();
+		}
+		echo.join();
+	});
+
+	return ms * 1e6 / rounds;
+}
+
+// Pushes and pops per second, growing from empty
+// and as a fixed window that never reallocates
+template <class D>
+double fill_drain_mops(int n)
+{
+	D dq;
+	double ms = measure_ms([&] {
+		for (int i = 0; i < n; ++i)
+			dq.push_back(i);
+		for (int i = 0; i < n; ++i)
+			dq.pop_front();
+	});
+	return 2.0 * n / ms / 1000.0;
+}
+
+template <class D>
+double sliding_window_mops(int n, int window)
+{
+	D dq;
+	for (int i = 0; i < window; ++i)
+		dq.push_back(i);
+
+	double ms = measure_ms([&] {
+		for (int i = 0; i < n; ++i) {
+			dq.push_back(i);
+			dq.pop_front();
+		}
+	});
+	return 2.0 * n / ms / 1000.0;
+}
 
+void bench_push_pop()
+{
+	const int n = 1 << 22;
+
+	std::cout << "fill/drain      Deque " << fill_drain_mops<Deque<int>>(n)
+		<< " Mops/s, std::deque " << fill_drain_mops<std::deque<int>>(n) << " Mops/s\n";
+	std::cout << "window of 1000  Deque " << sliding_window_mops<Deque<int>>(n, 1000)
+		<< " Mops/s, std::deque " << sliding_window_mops<std::deque<int>>(n, 1000) << " Mops/s\n";
+}
+
+void bench_spsc()
+{
+	std::cout << "SpscRing single    " << spsc_throughput(1) << " M msg/s\n";
+	std::cout << "SpscRing batch 64  " << spsc_throughput(64) << " M msg/s\n";
+	std::cout << "mutex + Deque      " << mutex_deque_throughput() << " M msg/s\n";
+	std::cout << "SpscRing round trip " << spsc_round_trip_ns() << " ns\n";
+}
+
+// Strings per second through the old sort + unique path,
+// the in-memory filter and the filter with a small budget
+void bench_dedup()
+{
+	const int n = 1 << 20;
+	std::vector<std::string> input(n);
+	std::mt19937 gen(7);
+	for (std::string& s : input)
+		s = "key-" + std::to_string(gen() % (n / 2));
+
+	size_t kept = 0;
+
+	double sort_ms = measure_ms([&] {
+		std::vector<std::string> arr(input);
+		std::sort(arr.begin(), arr.end());
+		arr.erase(std::unique(arr.begin(), arr.end()), arr.end());
+		kept = arr.size();
+	});
+	std::cout << "sort + unique   " << n / sort_ms / 1000.0 << " M strings/s, kept " << kept << '\n';
+
+	for (size_t budget : { (size_t)0, (size_t)1 << 20 }) {
+		Dedup_stream<std::string> seen(budget);
+		std::vector<std::string> out;
+		double ms = measure_ms([&] {
+			dedup(input.begin(), input.end(), std::back_inserter(out), seen);
+		});
+		std::cout << (budget ? "1 MB + spill    " : "in memory       ") << n / ms / 1000.0
+			<< " M strings/s, kept " << out.size() << ", runs " << seen.spilled_runs() << '\n';
+	}
+
+	Deque_taska<std::string> task;
+	Deque<std::string> dq;
+	for (int i = 0; i < n; ++i)
+		task.add_elems(dq, input[i]);
+	double task_ms = measure_ms([&] { task.findDublicates(dq); });
+	std::cout << "findDublicates  " << n / task_ms / 1000.0 << " M strings/s, kept " << dq.size() << '\n';
+}
+
+int main() {
+	bench_payloads();
+	bench_push_pop();
+	bench_spsc();
+	bench_dedup();
 }
\ No newline at end of file
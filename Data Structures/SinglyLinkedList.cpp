@@ -1,5 +1,12 @@
 ﻿#include <iostream>
 #include <string>
+#include <vector>
+#include <mutex>
+#include <new>
+#include <cstdlib>
+#include <chrono>
+#include <forward_list>
+#include "../SmartPointers/SlotPool.h"
 template<class T>
 struct Node
 {
@@ -8,6 +15,41 @@ struct Node
 	Node() {}
 	Node(T data) :data(data) {}
 };
+
+// Node allocator shared by all lists of one T, so nodes can be spliced
+// between lists. Nodes are slots of the SlotPool for their size.
+template<class T>
+class NodePool
+{
+	using Pool = SlotPool<sizeof(Node<T>), alignof(Node<T>)>;
+
+public:
+	static void attach()
+	{
+		Pool::attach();
+	}
+
+	static Node<T>* create(T data)
+	{
+		void* slot = Pool::allocate();
+		try
+		{
+			return new (slot) Node<T>(std::move(data));
+		}
+		catch (...)
+		{
+			Pool::deallocate(slot);
+			throw;
+		}
+	}
+
+	static void destroy(Node<T>* node)
+	{
+		node->~Node<T>();
+		Pool::deallocate(node);
+	}
+};
+
 template<class T>
 class SinglyLinkedList
 {
@@ -15,48 +57,166 @@ class SinglyLinkedList
 	Node<T>*  head;
 	Node<T>*  tail;
 public:
+	// Ties the pool's lifetime to the list, so even a list with static
+	// storage duration is emptied before the pool's blocks are freed
 	SinglyLinkedList()
 	{
 		head = tail = nullptr;
 		size = 0;
+		NodePool<T>::attach();
 	}
+
+	SinglyLinkedList(const SinglyLinkedList&) = delete;
+	SinglyLinkedList& operator=(const SinglyLinkedList&) = delete;
+
+	~SinglyLinkedList()
+	{
+		while (head)
+			pop_front();
+	}
+
 	void push(T data)
 	{
+		Node<T>* newNode = NodePool<T>::create(std::move(data));
 		if (!head)
 		{
-			head = new Node<T>(data);
-			tail = head;
+			head = tail = newNode;
 		}
 		else {
-			Node<T>*  newNode = new Node<T>(data);
-
 			tail->next = newNode;
 			tail = newNode;
 		}
 		++size;
 
 	}
-	void pop()
+
+	void push_front(T data)
 	{
-		if (!head)return;
-		Node<T>* temp = tail;
+		Node<T>* newNode = NodePool<T>::create(std::move(data));
+		newNode->next = head;
+		head = newNode;
+		if (!tail)
+			tail = newNode;
+		++size;
+	}
 
-		tail = temp->next;
+	void pop_front()
+	{
+		if (!head) return;
+		Node<T>* temp = head;
+		head = head->next;
+		if (!head)
+			tail = nullptr;
+		NodePool<T>::destroy(temp);
+		--size;
+	}
+
+	// Removes the last element. A singly linked list has to walk to the
+	// node before the tail, so this is O(n); prefer pop_front.
+	void pop()
+	{
+		if (!head) return;
+		if (head == tail)
+		{
+			pop_front();
+			return;
+		}
+		Node<T>* temp = head;
+		while (temp->next != tail)
+			temp = temp->next;
 
-		delete temp;
+		NodePool<T>::destroy(tail);
+		tail = temp;
+		tail->next = nullptr;
 		--size;
+	}
+
+	T& front()
+	{
+		if (!head)
+		{
+			std::cout << "SinglyLinkedList::front on empty list" << std::endl;
+			abort();
+		}
+		return head->data;
+	}
 
+	T& back()
+	{
+		if (!tail)
+		{
+			std::cout << "SinglyLinkedList::back on empty list" << std::endl;
+			abort();
+		}
+		return tail->data;
 	}
+
 	T  peek()
 	{
-		Node<T>* newNode = head;
-		int counter = 1;
-		while (newNode) {
+		return back();
+	}
 
-			if (counter == size) return newNode->data;			
-			++counter;
-			newNode = newNode->next;
+	// Moves all nodes of other to the end of this list
+	void splice(SinglyLinkedList& other)
+	{
+		if (!other.head || &other == this) return;
+		if (!head)
+			head = other.head;
+		else
+			tail->next = other.head;
+		tail = other.tail;
+		size += other.size;
+		other.head = other.tail = nullptr;
+		other.size = 0;
+	}
+
+	// Merges sorted other into this sorted list by relinking nodes
+	void merge(SinglyLinkedList& other)
+	{
+		if (&other == this) return;
+		Node<T>* a = head;
+		Node<T>* b = other.head;
+		Node<T>** link = &head;
+		while (a && b)
+		{
+			if (b->data < a->data)
+			{
+				*link = b;
+				b = b->next;
+			}
+			else
+			{
+				*link = a;
+				a = a->next;
+			}
+			link = &(*link)->next;
+		}
+		*link = a ? a : b;
+		if (b)
+			tail = other.tail;
+		size += other.size;
+		other.head = other.tail = nullptr;
+		other.size = 0;
+	}
+
+	void reverse()
+	{
+		Node<T>* prev = nullptr;
+		Node<T>* temp = head;
+		tail = head;
+		while (temp)
+		{
+			Node<T>* next = temp->next;
+			temp->next = prev;
+			prev = temp;
+			temp = next;
 		}
+		head = prev;
+	}
+
+	int length()
+	{
+		return size;
 	}
 
 	void display()
@@ -74,6 +234,270 @@ public:
 	}
 };
 
+// Link embedded in a user type for IntrusiveSList. Debug builds also
+// record the owning list to catch double links and foreign unlinks.
+template<class T>
+struct SListHook
+{
+	T* next = nullptr;
+#ifndef NDEBUG
+	const void* owner = nullptr;
+#endif
+};
+
+// Singly linked list over items that carry their own SListHook member.
+// Nothing is allocated or copied; linking at either end and unlinking
+// the front or the successor of a known item are O(1).
+template<class T, SListHook<T> T::*Hook>
+class IntrusiveSList
+{
+	T* head;
+	T* tail;
+	int size;
+
+	static SListHook<T>& hook(T* item)
+	{
+		return item->*Hook;
+	}
+
+	void check_owner(T& item, const void* expected, const char* message)
+	{
+#ifndef NDEBUG
+		if (hook(&item).owner != expected)
+		{
+			std::cout << message << std::endl;
+			abort();
+		}
+#else
+		(void)item; (void)expected; (void)message;
+#endif
+	}
+
+	void set_owner(T& item, const void* owner)
+	{
+#ifndef NDEBUG
+		hook(&item).owner = owner;
+#else
+		(void)item; (void)owner;
+#endif
+	}
+
+public:
+	IntrusiveSList()
+	{
+		head = tail = nullptr;
+		size = 0;
+	}
+
+	IntrusiveSList(const IntrusiveSList&) = delete;
+	IntrusiveSList& operator=(const IntrusiveSList&) = delete;
+
+	~IntrusiveSList()
+	{
+		clear();
+	}
+
+	void push(T& item)
+	{
+		check_owner(item, nullptr, "Item is already linked");
+		set_owner(item, this);
+		hook(&item).next = nullptr;
+		if (tail) hook(tail).next = &item;
+		else head = &item;
+		tail = &item;
+		++size;
+	}
+
+	void push_front(T& item)
+	{
+		check_owner(item, nullptr, "Item is already linked");
+		set_owner(item, this);
+		hook(&item).next = head;
+		if (!head) tail = &item;
+		head = &item;
+		++size;
+	}
+
+	T* pop_front()
+	{
+		T* item = head;
+		if (!item) return nullptr;
+		check_owner(*item, this, "Item is not linked into this list");
+		set_owner(*item, nullptr);
+		head = hook(item).next;
+		if (!head) tail = nullptr;
+		hook(item).next = nullptr;
+		--size;
+		return item;
+	}
+
+	// Unlinks and returns the item following prev
+	T* erase_after(T& prev)
+	{
+		check_owner(prev, this, "Item is not linked into this list");
+		T* item = hook(&prev).next;
+		if (!item) return nullptr;
+		set_owner(*item, nullptr);
+		hook(&prev).next = hook(item).next;
+		if (tail == item) tail = &prev;
+		hook(item).next = nullptr;
+		--size;
+		return item;
+	}
+
+	T* front()
+	{
+		return head;
+	}
+
+	T* back()
+	{
+		return tail;
+	}
+
+	static T* next(T& item)
+	{
+		return hook(&item).next;
+	}
+
+	// Unlinks every item; the items themselves are left alone
+	void clear()
+	{
+		while (head)
+			pop_front();
+	}
+
+	template<class F>
+	void for_each(F f)
+	{
+		for (T* item = head; item; item = hook(item).next)
+			f(*item);
+	}
+
+	int length()
+	{
+		return size;
+	}
+
+	bool empty()
+	{
+		return head == nullptr;
+	}
+};
+
+template <class F>
+double measure_ms(F&& fn)
+{
+	auto start = std::chrono::steady_clock::now();
+	fn();
+	auto stop = std::chrono::steady_clock::now();
+	return std::chrono::duration<double, std::milli>(stop - start).count();
+}
+
+// Build two long sorted lists, merge, reverse, then drain from the front
+void bench_long_lists()
+{
+	const int n = 1 << 20;
+	long long sum = 0;
+
+	double list_ms = measure_ms([&] {
+		SinglyLinkedList<int> a, b;
+		for (int i = 0; i < n; ++i)
+		{
+			a.push(2 * i);
+			b.push(2 * i + 1);
+		}
+		a.merge(b);
+		a.reverse();
+		while (!a.empty())
+		{
+			sum += a.front();
+			a.pop_front();
+		}
+	});
+
+	double std_ms = measure_ms([&] {
+		std::forward_list<int> a, b;
+		auto ia = a.before_begin(), ib = b.before_begin();
+		for (int i = 0; i < n; ++i)
+		{
+			ia = a.insert_after(ia, 2 * i);
+			ib = b.insert_after(ib, 2 * i + 1);
+		}
+		a.merge(b);
+		a.reverse();
+		while (!a.empty())
+		{
+			sum += a.front();
+			a.pop_front();
+		}
+	});
+
+	std::cout << "SinglyLinkedList " << list_ms << " ms, std::forward_list " << std_ms
+		<< " ms (checksum " << sum << ")\n";
+}
+
+struct PooledEntry
+{
+	int key;
+	long long payload[6];
+	SListHook<PooledEntry> hook;
+};
+
+// FIFO eviction churn over pooled entries: the oldest entry leaves the
+// front and is reused at the back
+void bench_intrusive_churn()
+{
+	const int n = 100000;
+	const int ops = 4000000;
+	long long sum = 0;
+
+	std::vector<PooledEntry> pool(n);
+	for (int i = 0; i < n; ++i)
+		pool[i].key = i;
+
+	IntrusiveSList<PooledEntry, &PooledEntry::hook> fifo;
+	for (PooledEntry& entry : pool) fifo.push(entry);
+	double intrusive_ms = measure_ms([&] {
+		for (int i = 0; i < ops; ++i)
+		{
+			PooledEntry* entry = fifo.pop_front();
+			sum += entry->key;
+			fifo.push(*entry);
+		}
+	});
+	fifo.clear();
+
+	SinglyLinkedList<PooledEntry> copied;
+	for (PooledEntry& entry : pool) copied.push(entry);
+	double copy_ms = measure_ms([&] {
+		for (int i = 0; i < ops; ++i)
+		{
+			PooledEntry entry = copied.front();
+			copied.pop_front();
+			sum += entry.key;
+			copied.push(entry);
+		}
+	});
+
+	std::forward_list<PooledEntry> reference;
+	auto last = reference.before_begin();
+	for (PooledEntry& entry : pool) last = reference.insert_after(last, entry);
+	double std_ms = measure_ms([&] {
+		for (int i = 0; i < ops; ++i)
+		{
+			PooledEntry entry = reference.front();
+			reference.pop_front();
+			sum += entry.key;
+			last = reference.insert_after(last, entry);
+		}
+	});
+
+	std::cout << "FIFO churn, " << ops << " moves: IntrusiveSList " << intrusive_ms
+		<< " ms, SinglyLinkedList " << copy_ms << " ms, std::forward_list "
+		<< std_ms << " ms (" << sum << ")\n";
+}
+
 
 int main()
 {
@@ -94,5 +518,10 @@ int main()
 	lst.display();
 
 	std::cout << (lst.peek());
+
+	std::cout << '\n';
+
+	bench_long_lists();
+	bench_intrusive_churn();
 }
 
@@ -1,4 +1,18 @@
 ﻿#include<iostream>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <chrono>
+#include <stack>
+#include <iterator>
+#include <type_traits>
+#include <new>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
 
 template<class T>
 struct Node {
@@ -12,6 +26,15 @@ class Stack {
 public:
 	Stack() { top = nullptr; }
 
+	Stack(const Stack&) = delete;
+	Stack& operator=(const Stack&) = delete;
+
+	~Stack()
+	{
+		while (top)
+			pop();
+	}
+
 	void push(T data)
 	{
 		Node<T>* temp = new Node<T>(data);
@@ -28,12 +51,12 @@ public:
 	}
 
 
-	int peek()
+	// Throws std::out_of_range on an empty stack
+	T peek()
 	{
-		if (!isEmpty())
-			return top->data;
-		else
-			exit(1);
+		if (isEmpty())
+			throw std::out_of_range("Stack::peek");
+		return top->data;
 	}
 
 
@@ -63,6 +86,431 @@ public:
 };
 
 
+// Contiguous stack. The first N elements live in an inline buffer, so
+// shallow stacks never touch the heap; deeper ones move to a malloc'd
+// array that doubles as needed. The bounds are kept as pointers, which
+// an element store can never alias.
+template<class T, int N = 16>
+class ArrayStack {
+	alignas(T) unsigned char buffer[sizeof(T) * N];
+	T* data;
+	T* end;
+	T* limit;
+
+	bool onHeap() const { return data != reinterpret_cast<const T*>(buffer); }
+
+	void grow(int minCapacity)
+	{
+		int count = size();
+		int newCapacity = (int)(limit - data) * 2;
+		if (newCapacity < minCapacity)
+			newCapacity = minCapacity;
+
+		T* temp = static_cast<T*>(malloc(sizeof(T) * newCapacity));
+		if (!temp)
+			throw std::bad_alloc();
+
+		if constexpr (std::is_trivially_copyable_v<T>) {
+			if (count)
+				memcpy(temp, data, sizeof(T) * count);
+		}
+		else {
+			int i = 0;
+			try {
+				for (; i < count; ++i)
+					new (temp + i) T(std::move_if_noexcept(data[i]));
+			}
+			catch (...) {
+				while (i--)
+					temp[i].~T();
+				free(temp);
+				throw;
+			}
+			for (i = 0; i < count; ++i)
+				data[i].~T();
+		}
+
+		if (onHeap())
+			free(data);
+		data = temp;
+		end = temp + count;
+		limit = temp + newCapacity;
+	}
+
+public:
+	ArrayStack() : data(reinterpret_cast<T*>(buffer)), end(data), limit(data + N) {}
+
+	ArrayStack(const ArrayStack&) = delete;
+	ArrayStack& operator=(const ArrayStack&) = delete;
+
+	~ArrayStack()
+	{
+		pop_n(size());
+		if (onHeap())
+			free(data);
+	}
+
+	template <class ...Args>
+	T& emplace(Args&& ...args)
+	{
+		if (end == limit) {
+			// The arguments may refer into the array being replaced
+			T x(std::forward<Args>(args)...);
+			grow(size() + 1);
+			return *new (end++) T(std::move(x));
+		}
+		return *new (end++) T(std::forward<Args>(args)...);
+	}
+
+	void push(const T& value) { emplace(value); }
+	void push(T&& value) { emplace(std::move(value)); }
+
+	template <class It>
+	void push_range(It first, It last)
+	{
+		if constexpr (std::is_base_of_v<std::forward_iterator_tag, typename std::iterator_traits<It>::iterator_category>) {
+			int n = (int)std::distance(first, last);
+			if (n > limit - end)
+				grow(size() + n);
+		}
+		for (; first != last; ++first)
+			emplace(*first);
+	}
+
+	// The stack must not be empty
+	T& top()
+	{
+		return end[-1];
+	}
+
+	void pop()
+	{
+		if (end != data)
+			(--end)->~T();
+	}
+
+	// Pops min(n, size()) elements
+	void pop_n(int n)
+	{
+		if (n > size())
+			n = size();
+		if constexpr (!std::is_trivially_destructible_v<T>) {
+			for (T* p = end - n; p != end; ++p)
+				p->~T();
+		}
+		end -= n;
+	}
+
+	bool isEmpty()
+	{
+		return end == data;
+	}
+
+	int size()
+	{
+		return (int)(end - data);
+	}
+
+	void display()
+	{
+		for (T* p = end; p != data;)
+			std::cout << *--p << "\n";
+	}
+};
+
+template<class T>
+struct AtomicNode {
+	T data;
+	std::atomic<AtomicNode*> next;
+	AtomicNode(T n) :data(n), next(nullptr) {}
+};
+
+// Head of a Treiber stack. The pointer lives in the low 48 bits and a
+// modification count in the top 16, so a head that was popped and pushed
+// back between a load and a CAS no longer compares equal (ABA).
+template<class N>
+class TaggedHead {
+	static_assert(sizeof(void*) == 8, "TaggedHead packs a tag into 64-bit pointers");
+	static constexpr uint64_t ptrMask = (1ULL << 48) - 1;
+
+	std::atomic<uint64_t> word;
+
+	static N* ptr(uint64_t w) { return reinterpret_cast<N*>(w & ptrMask); }
+	static uint64_t make(N* p, uint64_t old)
+	{
+		return reinterpret_cast<uint64_t>(p) | ((old & ~ptrMask) + (1ULL << 48));
+	}
+public:
+	TaggedHead() : word(0) {}
+
+	bool isEmpty() const { return ptr(word.load(std::memory_order_acquire)) == nullptr; }
+
+	// One CAS attempt, false if another thread got in first
+	bool try_push(N* n)
+	{
+		uint64_t old = word.load(std::memory_order_relaxed);
+		n->next.store(ptr(old), std::memory_order_relaxed);
+		return word.compare_exchange_strong(old, make(n, old), std::memory_order_release, std::memory_order_relaxed);
+	}
+
+	void push(N* n)
+	{
+		while (!try_push(n)) {}
+	}
+
+	// One CAS attempt. Nodes are never freed while the stack lives, so
+	// reading next of a node that was popped meanwhile is harmless.
+	enum Result { Popped, Empty, Contended };
+	Result try_pop(N*& out)
+	{
+		uint64_t old = word.load(std::memory_order_acquire);
+		N* top = ptr(old);
+		if (!top)
+			return Empty;
+		N* next = top->next.load(std::memory_order_relaxed);
+		if (!word.compare_exchange_strong(old, make(next, old), std::memory_order_acquire, std::memory_order_relaxed))
+			return Contended;
+		out = top;
+		return Popped;
+	}
+
+	N* pop()
+	{
+		N* n = nullptr;
+		while (try_pop(n) == Contended) {}
+		return n;
+	}
+};
+
+// Lock-free stack for many pushing and popping threads. A push or pop
+// that loses a CAS on the head tries the elimination array: a pusher
+// parks its node in a random slot for a moment, and a popper that finds
+// it there takes it, so the pair completes without touching the head.
+template<class T>
+class LockFreeStack {
+	static constexpr int slots = 16;
+	static constexpr int parkSpins = 64;
+
+	// A slot packs the parked node and a change count the way TaggedHead
+	// does. Nodes are recycled, so once a popper takes a node another
+	// pusher may park the same address; the count keeps the first pusher
+	// from mistaking that for its own offer.
+	struct alignas(64) Slot {
+		std::atomic<uint64_t> word{ 0 };
+	};
+
+	static constexpr uint64_t ptrMask = (1ULL << 48) - 1;
+
+	static AtomicNode<T>* slot_node(uint64_t w)
+	{
+		return reinterpret_cast<AtomicNode<T>*>(w & ptrMask);
+	}
+
+	static uint64_t slot_word(AtomicNode<T>* n, uint64_t old)
+	{
+		return reinterpret_cast<uint64_t>(n) | ((old & ~ptrMask) + (1ULL << 48));
+	}
+
+	alignas(64) TaggedHead<AtomicNode<T>> top;
+	// Popped nodes are recycled, only the destructor deletes them
+	alignas(64) TaggedHead<AtomicNode<T>> freeNodes;
+	Slot elimination[slots];
+
+	static int random_slot()
+	{
+		thread_local uint32_t state = 2463534242u ^ (uint32_t)std::hash<std::thread::id>()(std::this_thread::get_id());
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+		return state % slots;
+	}
+
+	bool eliminate_push(AtomicNode<T>* node)
+	{
+		Slot& s = elimination[random_slot()];
+		uint64_t old = s.word.load(std::memory_order_relaxed);
+		if (slot_node(old))
+			return false;
+		uint64_t parked = slot_word(node, old);
+		if (!s.word.compare_exchange_strong(old, parked, std::memory_order_release, std::memory_order_relaxed))
+			return false;
+
+		for (int i = 0; i < parkSpins; ++i)
+			if (s.word.load(std::memory_order_relaxed) != parked)
+				return true;
+
+		// Nobody came, take the node back unless a popper just did
+		uint64_t expected = parked;
+		return !s.word.compare_exchange_strong(expected, slot_word(nullptr, parked), std::memory_order_relaxed);
+	}
+
+	AtomicNode<T>* eliminate_pop()
+	{
+		Slot& s = elimination[random_slot()];
+		uint64_t w = s.word.load(std::memory_order_acquire);
+		AtomicNode<T>* node = slot_node(w);
+		if (node && s.word.compare_exchange_strong(w, slot_word(nullptr, w), std::memory_order_acquire, std::memory_order_relaxed))
+			return node;
+		return nullptr;
+	}
+
+	static void delete_all(TaggedHead<AtomicNode<T>>& head)
+	{
+		while (AtomicNode<T>* n = head.pop())
+			delete n;
+	}
+
+public:
+	LockFreeStack() {}
+
+	// Must not race with push or pop
+	~LockFreeStack()
+	{
+		delete_all(top);
+		delete_all(freeNodes);
+	}
+
+	void push(T data)
+	{
+		AtomicNode<T>* node = freeNodes.pop();
+		if (node)
+			node->data = std::move(data);
+		else
+			node = new AtomicNode<T>(std::move(data));
+
+		while (!top.try_push(node))
+			if (eliminate_push(node))
+				return;
+	}
+
+	// Returns false when the stack is empty
+	bool pop(T& out)
+	{
+		AtomicNode<T>* node = nullptr;
+		while (true)
+		{
+			typename TaggedHead<AtomicNode<T>>::Result r = top.try_pop(node);
+			if (r == TaggedHead<AtomicNode<T>>::Empty)
+				return false;
+			if (r == TaggedHead<AtomicNode<T>>::Popped)
+				break;
+			if ((node = eliminate_pop()))
+				break;
+		}
+
+		out = std::move(node->data);
+		freeNodes.push(node);
+		return true;
+	}
+
+	bool isEmpty()
+	{
+		return top.isEmpty();
+	}
+};
+
+template <class F>
+double measure_ms(F&& fn)
+{
+	auto start = std::chrono::steady_clock::now();
+	fn();
+	auto stop = std::chrono::steady_clock::now();
+	return std::chrono::duration<double, std::milli>(stop - start).count();
+}
+
+// Evaluation-style loop: two operands in, one result out, with the
+// depth wandering between 1 and 32
+template <class Push, class Pop, class Top>
+double eval_mops(int ops, Push push, Pop pop, Top top)
+{
+	long long acc = 0;
+	double ms = measure_ms([&] {
+		int depth = 0;
+		for (int i = 0; i < ops; ++i) {
+			if (depth < 2 || (depth < 32 && (i * 2654435761u) % 7 < 4)) {
+				push(i & 255);
+				++depth;
+			}
+			else {
+				int b = top();
+				pop();
+				int a = top();
+				pop();
+				push(a + b);
+				--depth;
+			}
+		}
+		acc = depth ? top() : 0;
+	});
+	if (acc < 0)
+		std::cout << acc;
+	return ops / ms / 1000.0;
+}
+
+void bench_array_stack()
+{
+	const int ops = 1 << 24;
+
+	Stack<int> linked;
+	std::stack<int, std::vector<int>> vec;
+	ArrayStack<int, 64> arr;
+
+	std::cout << "linked Stack       " << eval_mops(ops,
+		[&](int v) { linked.push(v); }, [&] { linked.pop(); }, [&] { return linked.peek(); }) << " Mops/s\n";
+	std::cout << "std::stack<vector> " << eval_mops(ops,
+		[&](int v) { vec.push(v); }, [&] { vec.pop(); }, [&] { return vec.top(); }) << " Mops/s\n";
+	std::cout << "ArrayStack<int,64> " << eval_mops(ops,
+		[&](int v) { arr.push(v); }, [&] { arr.pop(); }, [&] { return arr.top(); }) << " Mops/s\n";
+}
+
+// Every thread pushes and pops in turn on one shared stack
+template <class Push, class Pop>
+double shared_stack_mops(int threads, int ops, Push push, Pop pop)
+{
+	double ms = measure_ms([&] {
+		std::vector<std::thread> pool;
+		for (int t = 0; t < threads; ++t)
+			pool.emplace_back([&, t] {
+				int value;
+				for (int i = 0; i < ops / threads; ++i) {
+					push(t + i);
+					pop(value);
+				}
+			});
+		for (std::thread& th : pool)
+			th.join();
+	});
+	return 2.0 * ops / ms / 1000.0;
+}
+
+void bench_concurrent()
+{
+	const int ops = 1 << 20;
+
+	for (int threads = 1; threads <= 64; threads *= 2) {
+		Stack<int> locked;
+		std::mutex m;
+		double mutex_mops = shared_stack_mops(threads, ops,
+			[&](int v) { std::lock_guard<std::mutex> lock(m); locked.push(v); },
+			[&](int& v) {
+				std::lock_guard<std::mutex> lock(m);
+				if (locked.isEmpty()) return false;
+				v = locked.peek();
+				locked.pop();
+				return true;
+			});
+
+		LockFreeStack<int> lockfree;
+		double lockfree_mops = shared_stack_mops(threads, ops,
+			[&](int v) { lockfree.push(v); },
+			[&](int& v) { return lockfree.pop(v); });
+
+		std::cout << threads << " threads: mutex Stack " << mutex_mops
+			<< " Mops/s, LockFreeStack " << lockfree_mops << " Mops/s\n";
+	}
+}
+
+
 int main()
 {
 
@@ -83,6 +531,8 @@ int main()
 	
 	s.display();
 
+	bench_array_stack();
+	bench_concurrent();
 
 	return 0;
 }
\ No newline at end of file
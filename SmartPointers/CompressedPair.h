@@ -0,0 +1,50 @@
+﻿#pragma once
+#include <type_traits>
+#include <utility>
+
+// Holds one value. An empty, non-final class is kept as a private base, so
+// it adds no bytes to whatever derives from this; anything else (a function
+// pointer, a final or stateful class) is an ordinary member.
+template <class T, bool = std::is_empty<T>::value && !std::is_final<T>::value>
+struct EboStorage : private T {
+	EboStorage() = default;
+
+	template <class U, class = std::enable_if_t<!std::is_base_of<EboStorage, std::decay_t<U>>::value>>
+	explicit EboStorage(U&& value) noexcept(std::is_nothrow_constructible<T, U&&>::value)
+		: T(std::forward<U>(value)) {}
+
+	T& get() noexcept { return *this; }
+	const T& get() const noexcept { return *this; }
+};
+
+template <class T>
+struct EboStorage<T, false> {
+	T value;
+
+	EboStorage() = default;
+
+	template <class U, class = std::enable_if_t<!std::is_base_of<EboStorage, std::decay_t<U>>::value>>
+	explicit EboStorage(U&& value) noexcept(std::is_nothrow_constructible<T, U&&>::value)
+		: value(std::forward<U>(value)) {}
+
+	T& get() noexcept { return value; }
+	const T& get() const noexcept { return value; }
+};
+
+// First plus a deleter or allocator that costs nothing when it is stateless
+template <class Second, class First>
+struct CompressedPair : private EboStorage<Second> {
+	First first;
+
+	template <class D>
+	CompressedPair(First f, D&& d) noexcept(std::is_nothrow_constructible<Second, D&&>::value)
+		: EboStorage<Second>(std::forward<D>(d)), first(f) {}
+
+	// Leaves first default-initialized, for storage the owner fills in
+	template <class D, class = std::enable_if_t<!std::is_same<std::decay_t<D>, CompressedPair>::value>>
+	explicit CompressedPair(D&& d) noexcept(std::is_nothrow_constructible<Second, D&&>::value)
+		: EboStorage<Second>(std::forward<D>(d)) {}
+
+	Second& second() noexcept { return EboStorage<Second>::get(); }
+	const Second& second() const noexcept { return EboStorage<Second>::get(); }
+};
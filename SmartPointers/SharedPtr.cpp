@@ -3,278 +3,487 @@
 #include <algorithm>
 #include <stdexcept>
 #include <memory>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <thread>
+#include <mutex>
+#include "SharedPtr.h"
+#include "SlotPool.h"
 using namespace std;
 
-template<class T>
-class Shared_ptr
-{
-	T* m_ptr;
-	uint32_t *m_refCount;
-public:
-	Shared_ptr(T* ptr = nullptr) :m_ptr(ptr)
-	{
-		if (m_ptr)
-			m_refCount = new uint32_t(1);
-		else
-			m_refCount = nullptr;
-	}
-
-	Shared_ptr(T* data, std::default_delete<T>& dl) : m_ptr(data) {}
-
-	~Shared_ptr()
-	{
-		if (m_refCount != nullptr) {
-			(*m_refCount)--;
-			if ((*m_refCount) == 0) {
-				delete m_ptr;
-				delete m_refCount;
-			}
-		}
-	}
+// Every operator new in the program is counted, so benchmarks can report
+// allocations per object
+std::atomic<size_t> allocationCount{ 0 };
 
+void* operator new(size_t size)
+{
+	allocationCount.fetch_add(1, std::memory_order_relaxed);
+	if (void* p = malloc(size ? size : 1))
+		return p;
+	throw std::bad_alloc();
+}
 
-	Shared_ptr(const Shared_ptr& a)
-	{
-		m_ptr = a.m_ptr;
-		m_refCount = a.m_refCount;
-		(*m_refCount)++;
-	}
-	Shared_ptr& operator=(const Shared_ptr& a)
-	{
-		m_ptr = a.m_ptr;
-		m_refCount = a.m_refCount;
-		(*m_refCount)++;
-		return *this;
-	}
-
-	Shared_ptr(Shared_ptr&& a) : m_ptr(a.m_ptr), m_refCount(a.m_refCount)
-	{
-		a.m_ptr = nullptr;
-		a.m_refCount = nullptr;
-	}
+void operator delete(void* p) noexcept
+{
+	free(p);
+}
 
-	Shared_ptr& operator=(Shared_ptr&& a)
-	{
-		if (&a == this)
-			return *this;
+void operator delete(void* p, size_t) noexcept
+{
+	free(p);
+}
 
-		delete m_ptr;
-		delete m_refCount;
+template <class F>
+double measure_ms(F&& fn)
+{
+	auto start = std::chrono::steady_clock::now();
+	fn();
+	auto stop = std::chrono::steady_clock::now();
+	return std::chrono::duration<double, std::milli>(stop - start).count();
+}
 
-		m_ptr = a.m_ptr;
-		a.m_ptr = nullptr;
+struct Payload
+{
+	int id;
+	double weight[5];
+	explicit Payload(int id) :id(id), weight{} {}
+};
 
-		m_refCount = a.m_refCount;
-		a.m_refCount = nullptr;
+// Create n objects, copy every pointer once (touching count and object),
+// then destroy them all
+template <class Ptr, class Create>
+void bench_creation(const char* name, Create create)
+{
+	const int n = 1000000;
+	std::vector<Ptr> objects;
+	objects.reserve(n);
+	size_t before = allocationCount.load();
+	long long sum = 0;
+
+	double create_ms = measure_ms([&] {
+		for (int i = 0; i < n; ++i)
+			objects.push_back(create(i));
+	});
+	size_t allocations = allocationCount.load() - before;
+
+	double copy_ms = measure_ms([&] {
+		for (const Ptr& p : objects)
+		{
+			Ptr copy = p;
+			sum += copy->id;
+		}
+	});
 
-		return *this;
-	}
+	double destroy_ms = measure_ms([&] { objects.clear(); });
 
-	Shared_ptr(std::weak_ptr<T>& x)
-	{
-		m_ptr = x.m_ptr;
-		m_refCount = x.m_refCount;
-		(*m_refCount)++;
-	};
+	std::cout << name << ": " << double(allocations) / n << " allocations/object, create "
+		<< create_ms << " ms, copy " << copy_ms << " ms, destroy " << destroy_ms
+		<< " ms (" << sum << ")\n";
+}
 
-	Shared_ptr& operator=(std::weak_ptr<T>& x)
+void bench_make_shared()
+{
+	bench_creation<Shared_ptr<Payload>>("Shared_ptr(new T)",
+		[](int i) { return Shared_ptr<Payload>(new Payload(i)); });
+	bench_creation<Shared_ptr<Payload>>("Make_shared",
+		[](int i) { return Make_shared<Payload>(i); });
+	bench_creation<std::shared_ptr<Payload>>("std::shared_ptr(new T)",
+		[](int i) { return std::shared_ptr<Payload>(new Payload(i)); });
+	bench_creation<std::shared_ptr<Payload>>("std::make_shared",
+		[](int i) { return std::make_shared<Payload>(i); });
+	// Carve the pool's blocks once so neither pooled run pays for them
 	{
-		m_ptr = x.m_ptr;
-		m_refCount = x.m_refCount;
-		(*m_refCount)++;
-		return *this;
+		std::vector<Shared_ptr<Payload>> warm;
+		for (int i = 0; i < 1000000; ++i)
+			warm.push_back(AllocateShared<Payload>(PoolAllocator<Payload>(), i));
 	}
+	bench_creation<Shared_ptr<Payload>>("AllocateShared(PoolAllocator)",
+		[](int i) { return AllocateShared<Payload>(PoolAllocator<Payload>(), i); });
+	bench_creation<std::shared_ptr<Payload>>("std::allocate_shared(PoolAllocator)",
+		[](int i) { return std::allocate_shared<Payload>(PoolAllocator<Payload>(), i); });
+	bench_creation<Shared_ptr<Payload>>("Shared_ptr(new T, std::default_delete)",
+		[](int i) { return Shared_ptr<Payload>(new Payload(i), std::default_delete<Payload>()); });
+}
+
+// Each thread copies one shared object's pointer and drops the copy;
+// every iteration is one increment and one decrement on the same count
+template <class Ptr>
+void bench_copy_destroy(const char* name, const Ptr& shared, int threads)
+{
+	const int iterations = 2000000;
+	std::vector<long long> sums(threads);
+	double ms = measure_ms([&] {
+		std::vector<std::thread> workers;
+		for (int t = 0; t < threads; ++t)
+			workers.emplace_back([&, t] {
+				long long sum = 0;
+				for (int i = 0; i < iterations; ++i)
+				{
+					Ptr copy = shared;
+					sum += copy->id;
+				}
+				sums[t] = sum;
+			});
+		for (std::thread& worker : workers)
+			worker.join();
+	});
+	std::cout << name << ", " << threads << " threads: "
+		<< ms * 1e6 / (double(iterations) * threads) << " ns/copy, use_count after "
+		<< shared.use_count() << "\n";
+}
+
+void bench_refcount()
+{
+	Shared_ptr<Payload> plain = Make_shared<Payload>(1);
+	bench_copy_destroy("Shared_ptr<SingleThreaded>", plain, 1);
 
-
-	T& operator*() const { return *m_ptr; }
-	T* operator->() const { return m_ptr; }
-
-
-	void swap(Shared_ptr& src) noexcept
+	Shared_ptr<Payload, ThreadSafe> atomic = Make_shared<Payload, ThreadSafe>(1);
+	std::shared_ptr<Payload> standard = std::make_shared<Payload>(1);
+	for (int threads : { 1, 2, 4, 8 })
 	{
-		std::swap(m_ptr, src.m_ptr);
+		bench_copy_destroy("Shared_ptr<ThreadSafe>", atomic, threads);
+		bench_copy_destroy("std::shared_ptr", standard, threads);
 	}
+}
 
-	int unique()
+// Readers load the current snapshot and read from it while one writer
+// keeps publishing new ones; reports the cost of a load and how many
+// snapshots the writer managed to publish meanwhile
+template <class Load, class Store>
+void bench_publish(const char* name, int readers, Load load, Store store)
+{
+	const int iterations = 500000;
+	std::atomic<int> running{ readers };
+	std::vector<long long> sums(readers);
+	long long published = 0;
+	double ms = measure_ms([&] {
+		std::thread writer([&] {
+			while (running.load(std::memory_order_relaxed) > 0)
+			{
+				store(int(++published));
+				std::this_thread::yield();
+			}
+		});
+		std::vector<std::thread> workers;
+		for (int t = 0; t < readers; ++t)
+			workers.emplace_back([&, t] {
+				long long sum = 0;
+				for (int i = 0; i < iterations; ++i)
+					sum += load()->id;
+				sums[t] = sum;
+				running.fetch_sub(1, std::memory_order_relaxed);
+			});
+		for (std::thread& worker : workers)
+			worker.join();
+		writer.join();
+	});
+	std::cout << name << ", " << readers << " readers: "
+		<< ms * 1e6 / (double(iterations) * readers) << " ns/load, "
+		<< published << " snapshots published\n";
+}
+
+void bench_snapshots()
+{
+	for (int readers : { 1, 2, 4 })
 	{
-		if (use_count() > 1)
-		{
-			return 0;
-		}
-		return 1;
+		AtomicSharedPtr<Payload> atomic(Make_shared<Payload, ThreadSafe>(0));
+		bench_publish("AtomicSharedPtr", readers,
+			[&] { return atomic.load(); },
+			[&](int id) { atomic.store(Make_shared<Payload, ThreadSafe>(id)); });
+
+		std::mutex lock;
+		Shared_ptr<Payload, ThreadSafe> guarded = Make_shared<Payload, ThreadSafe>(0);
+		bench_publish("mutex + Shared_ptr", readers,
+			[&] { std::lock_guard<std::mutex> hold(lock); return guarded; },
+			[&](int id) {
+				Shared_ptr<Payload, ThreadSafe> next = Make_shared<Payload, ThreadSafe>(id);
+				std::lock_guard<std::mutex> hold(lock);
+				guarded.swap(next);
+			});
+
+		std::shared_ptr<Payload> standard = std::make_shared<Payload>(0);
+		bench_publish("std::atomic_load(shared_ptr)", readers,
+			[&] { return std::atomic_load(&standard); },
+			[&](int id) { std::atomic_store(&standard, std::make_shared<Payload>(id)); });
 	}
+}
 
-	T* get()const { return m_ptr; }
-
-	T* release() noexcept
-	{
-		T* result = nullptr;
-		std::swap(result, m_ptr);
-		return result;
-	}
+template <class Policy>
+struct TreeNode
+{
+	Shared_ptr<TreeNode, Policy> left;
+	Shared_ptr<TreeNode, Policy> right;
+	Payload data;
+	explicit TreeNode(int id) :data(id) {}
+};
 
-	void reset()
+template <class Policy>
+Shared_ptr<TreeNode<Policy>, Policy> build_tree(int depth, int& id)
+{
+	Shared_ptr<TreeNode<Policy>, Policy> node = Make_shared<TreeNode<Policy>, Policy>(id++);
+	if (depth > 1)
 	{
-		T* tmp = release();
-		delete tmp;
-	}
-
-
-	bool operator==(std::nullptr_t) const {
-		return m_ptr == nullptr;
-	}
-
-	bool operator!=(const Shared_ptr& src) const {
-		return m_ptr != src.m_ptr;
-	}
-
-	bool operator==(const Shared_ptr& src) const {
-		return m_ptr == src.m_ptr;
+		node->left = build_tree<Policy>(depth - 1, id);
+		node->right = build_tree<Policy>(depth - 1, id);
 	}
+	return node;
+}
 
-	uint32_t use_count()
-	{
-		return *m_refCount;
-	}
-	friend std::ostream& operator<<(std::ostream& os, Shared_ptr<T>& sp)
+void report_latency(const char* name, std::vector<double>& samples)
+{
+	std::sort(samples.begin(), samples.end());
+	std::cout << name << ": p50 " << samples[samples.size() / 2] << " ms, p99 "
+		<< samples[samples.size() * 99 / 100] << " ms, max " << samples.back() << " ms\n";
+}
+
+// Time how long the owner of a tree is blocked when it drops the root
+template <class Policy>
+std::vector<double> bench_drop_tree(int rounds, int depth)
+{
+	std::vector<double> samples;
+	for (int round = 0; round < rounds; ++round)
 	{
-		os << "Address pointed : " << sp.get() << std::endl;
-		return os;
+		int id = 0;
+		Shared_ptr<TreeNode<Policy>, Policy> root = build_tree<Policy>(depth, id);
+		samples.push_back(measure_ms([&] { root.reset(); }));
 	}
+	return samples;
+}
 
-};
-
-
-template<class T>
-class Shared_ptr<T[]>
+void bench_reclaim()
 {
-	T* m_ptr;
-	uint32_t *m_refCount;
-public:
+	const int rounds = 100;
+	const int depth = 15;
 
-	Shared_ptr() {}
+	std::vector<double> immediate = bench_drop_tree<ThreadSafe>(rounds, depth);
+	report_latency("drop tree, immediate", immediate);
 
-	explicit Shared_ptr(T *m_ptr) {
-		Shared_ptr<T[]>::m_ptr = m_ptr;
-		m_refCount = new uint32_t(1);
-	}
-
-	Shared_ptr(const Shared_ptr<T[]>& a)
 	{
-		m_ptr = a.m_ptr;
-		m_refCount = a.m_refCount;
-		(*m_refCount)++;
+		BackgroundReclaimer<Deferred<>> reclaimer;
+		std::vector<double> deferred = bench_drop_tree<Deferred<>>(rounds, depth);
+		report_latency("drop tree, deferred + background thread", deferred);
 	}
 
-
-	Shared_ptr(Shared_ptr<T[]>&& a) : m_ptr(a.m_ptr), m_refCount(a.m_refCount)
+	// Drained by the owner between requests instead, in bounded batches
+	std::vector<double> batches;
+	for (int round = 0; round < rounds / 10; ++round)
 	{
-		a.m_ptr = nullptr;
-		a.m_refCount = nullptr;
+		int id = 0;
+		Shared_ptr<TreeNode<Deferred<>>, Deferred<>> root = build_tree<Deferred<>>(depth, id);
+		root.reset();
+		while (!ReclaimQueue<Deferred<>>::empty())
+			batches.push_back(measure_ms([] { ReclaimQueue<Deferred<>>::drain(1024); }));
 	}
+	report_latency("drain(1024) batch", batches);
 
-
-	Shared_ptr<T[]>& operator=(const Shared_ptr<T[]>& a)
+	// Far deeper than the stack allows when each node frees the next
+	using Chain = TreeNode<Deferred<>>;
+	Shared_ptr<Chain, Deferred<>> head;
+	for (int i = 0; i < 1000000; ++i)
 	{
-		m_ptr = a.m_ptr;
-		m_refCount = a.m_refCount;
-		(*m_refCount)++;
-		return *this;
+		Shared_ptr<Chain, Deferred<>> node = Make_shared<Chain, Deferred<>>(i);
+		node->left = std::move(head);
+		head = std::move(node);
 	}
+	size_t freed = 0;
+	double drop_ms = measure_ms([&] { head.reset(); });
+	double drain_ms = measure_ms([&] { freed = ReclaimQueue<Deferred<>>::drain(); });
+	std::cout << "drop 1000000-node chain, deferred: reset " << drop_ms << " ms, drain "
+		<< drain_ms << " ms, " << freed << " freed\n";
+}
+
+// A map entry whose value is handed out on its own, and a session that
+// hands out pointers to itself
+struct Entry
+{
+	int key;
+	std::vector<double> value;
+	explicit Entry(int key) :key(key), value(64, key) {}
+};
 
+struct Session : EnableSharedFromThis<Session>
+{
+	int id;
+	explicit Session(int id) :id(id) {}
+	Shared_ptr<Session> handle() { return shared_from_this(); }
+};
 
-	Shared_ptr<T[]>& operator=(Shared_ptr<T[]>&& a)
+template <class Share>
+void bench_share(const char* name, int n, Share share)
+{
+	size_t before = allocationCount.load();
+	double sum = 0;
+	double ms = measure_ms([&] {
+		for (int i = 0; i < n; ++i)
+			sum += share(i);
+	});
+	std::cout << name << ": " << ms * 1e6 / n << " ns/op, "
+		<< double(allocationCount.load() - before) / n << " allocations/op (" << sum << ")\n";
+}
+
+void bench_aliasing()
+{
+	const int n = 1000000;
+	Shared_ptr<Entry> entry = Make_shared<Entry>(3);
+	bench_share("value copied into Make_shared", n, [&](int i) {
+		Shared_ptr<std::vector<double>> value = Make_shared<std::vector<double>>(entry->value);
+		return (*value)[i % 64];
+	});
+	bench_share("value through aliasing Shared_ptr", n, [&](int i) {
+		Shared_ptr<std::vector<double>> value(entry, &entry->value);
+		return (*value)[i % 64];
+	});
+
+	Shared_ptr<Session> session = Make_shared<Session>(7);
+	Session* raw = session.get();
+	bench_share("Shared_ptr copy", n, [&](int) {
+		Shared_ptr<Session> copy = session;
+		return copy->id;
+	});
+	bench_share("shared_from_this", n, [&](int) {
+		Shared_ptr<Session> copy = raw->handle();
+		return copy->id;
+	});
+}
+
+// Cost of the paths containers of pointers run all the time: copying,
+// copy-assigning, moving, swapping and resetting, with 1000 live objects
+template <class Ptr, class Make>
+void bench_ops(const char* name, Make make)
+{
+	const int n = 1000000;
+	std::vector<Ptr> objects;
+	for (int i = 0; i < 1000; ++i)
+		objects.push_back(make(i));
+	std::vector<Ptr> slots(n);
+	long long sum = 0;
+
+	double copy_ms = measure_ms([&] {
+		for (int i = 0; i < n; ++i)
+		{
+			Ptr copy = objects[i % 1000];
+			sum += copy->id;
+		}
+	});
+	double assign_ms = measure_ms([&] {
+		for (int i = 0; i < n; ++i)
+			slots[i] = objects[i % 1000];
+	});
+	double move_ms = measure_ms([&] {
+		for (int i = 1; i < n; ++i)
+		{
+			Ptr moved = std::move(slots[i - 1]);
+			slots[i - 1] = std::move(slots[i]);
+			slots[i] = std::move(moved);
+		}
+	});
+	double swap_ms = measure_ms([&] {
+		for (int i = 1; i < n; ++i)
+			slots[i - 1].swap(slots[i]);
+	});
+	double reset_ms = measure_ms([&] {
+		for (Ptr& slot : slots)
+			slot.reset();
+	});
+	double null_ms = measure_ms([&] {
+		for (Ptr& slot : slots)
+			slot = Ptr(nullptr);
+	});
+
+	std::cout << name << " (ns/op): copy " << copy_ms * 1e6 / n << ", copy-assign " << assign_ms * 1e6 / n
+		<< ", move x3 " << move_ms * 1e6 / n << ", swap " << swap_ms * 1e6 / n
+		<< ", reset " << reset_ms * 1e6 / n << ", assign null " << null_ms * 1e6 / n
+		<< " (" << sum << ")\n";
+}
+
+void bench_paths()
+{
+	bench_ops<Shared_ptr<Payload>>("Shared_ptr<SingleThreaded>",
+		[](int i) { return Make_shared<Payload>(i); });
+	bench_ops<Shared_ptr<Payload, ThreadSafe>>("Shared_ptr<ThreadSafe>",
+		[](int i) { return Make_shared<Payload, ThreadSafe>(i); });
+	bench_ops<std::shared_ptr<Payload>>("std::shared_ptr",
+		[](int i) { return std::make_shared<Payload>(i); });
+
+	size_t before = allocationCount.load();
 	{
-		if (&a == this)
-			return *this;
-
-		delete m_ptr;
-		delete m_refCount;
-
-		m_ptr = a.m_ptr;
-		a.m_ptr = nullptr;
-
-		m_refCount = a.m_refCount;
-		a.m_refCount = nullptr;
-
-		return *this;
+		Shared_ptr<Payload> empty(nullptr);
+		empty.reset();
+		empty = nullptr;
+		Shared_ptr<Payload[]> array(nullptr);
+		array.reset();
 	}
+	std::cout << "allocations for null Shared_ptr: " << allocationCount.load() - before << "\n";
+}
 
+// Deleters and allocators that cannot be empty bases, a function pointer
+// and final classes, are kept as members of the block instead
+int deletedCount = 0;
 
+void delete_payload(Payload* p)
+{
+	++deletedCount;
+	delete p;
+}
 
-
-
-	~Shared_ptr()
+struct FinalDelete final
+{
+	void operator()(Payload* p) const
 	{
-		if (m_refCount != nullptr) {
-			(*m_refCount)--;
-			if ((*m_refCount) == 0) {
-				delete[] m_ptr;
-				delete m_refCount;
-			}
-		}
+		++deletedCount;
+		delete p;
 	}
+};
 
+template <class T>
+struct FinalAllocator final
+{
+	using value_type = T;
 
+	FinalAllocator() noexcept {}
+	template <class U>
+	FinalAllocator(const FinalAllocator<U>&) noexcept {}
 
+	T* allocate(size_t n) { return static_cast<T*>(::operator new(n * sizeof(T))); }
+	void deallocate(T* p, size_t) noexcept { ::operator delete(p); }
 
+	template <class U>
+	bool operator==(const FinalAllocator<U>&) const noexcept { return true; }
+	template <class U>
+	bool operator!=(const FinalAllocator<U>&) const noexcept { return false; }
+};
 
-	T& operator*() const { return *m_ptr; }
-	T* operator->() const { return m_ptr; }
-
-
-	void swap(Shared_ptr<T[]>& src) noexcept
-	{
-		std::swap(m_ptr, src.m_ptr);
-	}
-
-	int unique()
-	{
-		if (use_count() > 1)
-		{
-			return 0;
-		}
-		return 1;
-	}
-
-	T* get()const { return m_ptr; }
-
-	T* release() noexcept
-	{
-		T* result = nullptr;
-		std::swap(result, m_ptr);
-		return result;
-	}
+// Adopting a raw pointer must be spelled out; otherwise sp == raw would
+// build a temporary owner and delete the object
+static_assert(!std::is_convertible_v<Payload*, Shared_ptr<Payload>>, "Shared_ptr(T*) must be explicit");
 
-	void reset()
+void check_deleters()
+{
+	deletedCount = 0;
 	{
-		T* tmp = release();
-		delete tmp;
-	}
-	T& operator[](int pos) const {
-		return Shared_ptr<T[]>::m_ptr[pos];
+		Shared_ptr<Payload> byFunction(new Payload(1), &delete_payload);
+		Shared_ptr<Payload> byFinal(new Payload(2), FinalDelete());
+		Shared_ptr<Payload> copy = byFunction;
 	}
-	uint32_t use_count()
+	Shared_ptr<Payload> allocated = AllocateShared<Payload>(FinalAllocator<Payload>(), 3);
+	if (deletedCount != 2 || allocated->id != 3)
 	{
-		return *m_refCount;
+		std::cout << "check_deleters failed\n";
+		abort();
 	}
+	std::cout << "function pointer and final deleters: ok\n";
+}
 
-};
-template <class T, class ...Args>
-std::enable_if_t<!std::is_array_v<T>, Shared_ptr<T>>
-Make_shared(Args&& ...args)
-{
-	return Shared_ptr<T>(new T(std::forward<Args>(args)...));
-};
-
-template <class T>
-std::enable_if_t<std::is_array_v<T>, Shared_ptr<T>>
-Make_shared(int size)
-{
-	using type = std::remove_extent_t<T>;
-	return Shared_ptr<T>(new type[size]);
-};
 int main()
 {
-
+	check_deleters();
+	bench_make_shared();
+	bench_refcount();
+	bench_snapshots();
+	bench_reclaim();
+	bench_aliasing();
+	bench_paths();
 }
\ No newline at end of file
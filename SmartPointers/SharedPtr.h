@@ -0,0 +1,1133 @@
+﻿#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include "CompressedPair.h"
+
+// Reference count policies. SingleThreaded is a plain counter with no
+// synchronization cost; ThreadSafe is for objects shared across threads.
+// A new reference is always made from an existing one, so increments
+// can be relaxed, but the decrement that reaches zero must see every
+// other owner's writes before the object is destroyed.
+struct SingleThreaded
+{
+	using count_type = uint32_t;
+	static constexpr bool deferred = false;
+	static void increment(count_type& count) noexcept { ++count; }
+	static bool decrement(count_type& count) noexcept { return --count == 0; }
+	static uint32_t load(const count_type& count) noexcept { return count; }
+
+	static bool increment_if_nonzero(count_type& count) noexcept
+	{
+		if (count == 0)
+			return false;
+		++count;
+		return true;
+	}
+};
+
+struct ThreadSafe
+{
+	using count_type = std::atomic<uint32_t>;
+	static constexpr bool deferred = false;
+	static void increment(count_type& count) noexcept { count.fetch_add(1, std::memory_order_relaxed); }
+	static bool decrement(count_type& count) noexcept { return count.fetch_sub(1, std::memory_order_acq_rel) == 1; }
+	static uint32_t load(const count_type& count) noexcept { return count.load(std::memory_order_acquire); }
+
+	// Never revives an object whose last owner is already destroying it
+	static bool increment_if_nonzero(count_type& count) noexcept
+	{
+		uint32_t current = count.load(std::memory_order_relaxed);
+		while (current != 0)
+		{
+			if (count.compare_exchange_weak(current, current + 1, std::memory_order_acq_rel, std::memory_order_relaxed))
+				return true;
+		}
+		return false;
+	}
+};
+
+// Counts like Base, but an object whose last owner goes away is not
+// destroyed by that owner: its block is queued on ReclaimQueue and freed
+// later by drain(). Dropping the root of a large structure is then O(1),
+// and its children are freed one by one instead of recursively.
+template<class Base = ThreadSafe>
+struct Deferred : Base
+{
+	static constexpr bool deferred = true;
+};
+
+template<class Policy>
+struct ControlBlock;
+
+template<class Policy>
+class ReclaimQueue;
+
+// Link used by ReclaimQueue; only blocks of a Deferred policy carry it
+template<class Policy, bool = Policy::deferred>
+struct ReclaimLink {};
+
+template<class Policy>
+struct ReclaimLink<Policy, true>
+{
+	ControlBlock<Policy>* nextReclaim = nullptr;
+};
+
+// Counts shared by every Shared_ptr to one object. The weak count
+// includes one reference held collectively by the strong owners, so the
+// block outlives the object until the last observer lets go.
+template<class Policy>
+struct ControlBlock : ReclaimLink<Policy>
+{
+	typename Policy::count_type strong{ 1 };
+	typename Policy::count_type weak{ 1 };
+
+	virtual void destroy() noexcept = 0;
+	virtual void deallocate() noexcept = 0;
+
+	void release() noexcept
+	{
+		if (Policy::decrement(strong))
+		{
+			if constexpr (Policy::deferred)
+				ReclaimQueue<Policy>::push(this);
+			else
+				dispose();
+		}
+	}
+
+	void dispose() noexcept
+	{
+		destroy();
+		release_weak();
+	}
+
+	void release_weak() noexcept
+	{
+		if (Policy::decrement(weak))
+			deallocate();
+	}
+
+protected:
+	~ControlBlock() = default;
+};
+
+// Blocks of a Deferred policy waiting to be freed. Any thread may push
+// without locking; drainers take batches in turn and free them outside
+// the lock, so a destructor may drain again. Freeing a block releases its
+// object's own pointers, which only pushes their blocks here, so even a
+// chain of millions of nodes is freed without recursion.
+template<class Policy>
+class ReclaimQueue
+{
+	using Block = ControlBlock<Policy>;
+
+	static std::atomic<Block*>& incoming()
+	{
+		static std::atomic<Block*> head{ nullptr };
+		return head;
+	}
+
+	// Taken from incoming but not handed to a drainer yet; guarded by drainLock
+	static Block*& pending()
+	{
+		static Block* list = nullptr;
+		return list;
+	}
+
+	static std::mutex& drainLock()
+	{
+		static std::mutex lock;
+		return lock;
+	}
+
+	// Detaches up to limit blocks for the caller to free
+	static Block* take(size_t limit)
+	{
+		std::lock_guard<std::mutex> hold(drainLock());
+		Block*& list = pending();
+		if (!list)
+			list = incoming().exchange(nullptr, std::memory_order_acquire);
+		if (!list)
+			return nullptr;
+
+		Block* last = list;
+		for (size_t n = 1; n < limit && last->nextReclaim; ++n)
+			last = last->nextReclaim;
+		Block* batch = list;
+		list = last->nextReclaim;
+		last->nextReclaim = nullptr;
+		return batch;
+	}
+
+public:
+	static void push(Block* block) noexcept
+	{
+		Block* head = incoming().load(std::memory_order_relaxed);
+		do
+			block->nextReclaim = head;
+		while (!incoming().compare_exchange_weak(head, block, std::memory_order_release, std::memory_order_relaxed));
+	}
+
+	// Frees at most limit objects and returns how many it freed
+	static size_t drain(size_t limit = SIZE_MAX)
+	{
+		size_t freed = 0;
+		while (freed < limit)
+		{
+			Block* batch = take(limit - freed);
+			if (!batch)
+				break;
+			while (batch)
+			{
+				Block* block = batch;
+				batch = block->nextReclaim;
+				block->dispose();
+				++freed;
+			}
+		}
+		return freed;
+	}
+
+	// True when nothing is waiting; a concurrent drain may still be
+	// freeing the batch it took
+	static bool empty()
+	{
+		std::lock_guard<std::mutex> hold(drainLock());
+		return !pending() && !incoming().load(std::memory_order_acquire);
+	}
+};
+
+// Drains a Deferred policy's queue from its own thread in batches of at
+// most batch objects until destroyed, then frees whatever is left. The
+// objects are freed on another thread, so the counts must be atomic.
+template<class Policy>
+class BackgroundReclaimer
+{
+	static_assert(std::is_same_v<typename Policy::count_type, std::atomic<uint32_t>>,
+		"background reclamation needs a thread-safe policy");
+
+	std::atomic<bool> m_stop{ false };
+	std::thread m_thread;
+
+public:
+	explicit BackgroundReclaimer(size_t batch = 4096)
+		:m_thread([this, batch] {
+			while (!m_stop.load(std::memory_order_acquire))
+			{
+				if (ReclaimQueue<Policy>::drain(batch) == 0)
+					std::this_thread::sleep_for(std::chrono::microseconds(100));
+				else
+					std::this_thread::yield();
+			}
+		})
+	{
+	}
+
+	BackgroundReclaimer(const BackgroundReclaimer&) = delete;
+	BackgroundReclaimer& operator=(const BackgroundReclaimer&) = delete;
+
+	~BackgroundReclaimer()
+	{
+		m_stop.store(true, std::memory_order_release);
+		m_thread.join();
+		ReclaimQueue<Policy>::drain();
+	}
+};
+
+// Block for an object that was allocated separately with new
+template<class T, class Policy>
+struct PointerBlock final : ControlBlock<Policy>
+{
+	T* ptr;
+
+	explicit PointerBlock(T* ptr) :ptr(ptr) {}
+	void destroy() noexcept override { delete ptr; }
+	void deallocate() noexcept override { delete this; }
+};
+
+// Block with the object stored right after the counts, so Make_shared
+// costs one allocation and the counts share a cache line with the object
+template<class T, class Policy>
+struct InplaceBlock final : ControlBlock<Policy>
+{
+	alignas(T) unsigned char storage[sizeof(T)];
+
+	template<class ...Args>
+	explicit InplaceBlock(Args&& ...args)
+	{
+		new (storage) T(std::forward<Args>(args)...);
+	}
+	T* get() { return reinterpret_cast<T*>(storage); }
+	void destroy() noexcept override { get()->~T(); }
+	void deallocate() noexcept override { delete this; }
+};
+
+// Block for an object released through a custom deleter. The deleter
+// shares a CompressedPair with the pointer, so a stateless one adds no
+// bytes to the block.
+template<class T, class D, class Policy>
+struct DeleterBlock final : ControlBlock<Policy>
+{
+	CompressedPair<D, T*> pair;
+
+	DeleterBlock(T* ptr, D deleter) :pair(ptr, std::move(deleter)) {}
+	void destroy() noexcept override { pair.second()(pair.first); }
+	void deallocate() noexcept override { delete this; }
+};
+
+// In-place block whose memory comes from an allocator and goes back to it
+template<class T, class Alloc, class Policy>
+struct AllocatedBlock final : ControlBlock<Policy>
+{
+	struct Storage
+	{
+		alignas(T) unsigned char bytes[sizeof(T)];
+	};
+
+	CompressedPair<Alloc, Storage> pair;
+
+	template<class ...Args>
+	explicit AllocatedBlock(const Alloc& alloc, Args&& ...args) :pair(alloc)
+	{
+		new (pair.first.bytes) T(std::forward<Args>(args)...);
+	}
+	T* get() { return reinterpret_cast<T*>(pair.first.bytes); }
+	void destroy() noexcept override { get()->~T(); }
+	void deallocate() noexcept override
+	{
+		using BlockAlloc = typename std::allocator_traits<Alloc>::template rebind_alloc<AllocatedBlock>;
+		BlockAlloc alloc(pair.second());
+		this->~AllocatedBlock();
+		std::allocator_traits<BlockAlloc>::deallocate(alloc, this, 1);
+	}
+};
+
+template<class T, class Policy = SingleThreaded>
+class Shared_ptr;
+
+template<class T, class Policy = SingleThreaded>
+class WeakPtr;
+
+template<class T, class Policy = SingleThreaded>
+class EnableSharedFromThis;
+
+template <class T, class Policy = SingleThreaded, class ...Args>
+std::enable_if_t<!std::is_array_v<T>, Shared_ptr<T, Policy>>
+Make_shared(Args&& ...args);
+
+template <class T, class Policy = SingleThreaded, class Alloc, class ...Args>
+Shared_ptr<T, Policy> AllocateShared(const Alloc& alloc, Args&& ...args);
+
+template<class T, class Policy>
+class Shared_ptr
+{
+	T* m_ptr;
+	ControlBlock<Policy>* m_ctrl;
+
+	Shared_ptr(T* ptr, ControlBlock<Policy>* ctrl) :m_ptr(ptr), m_ctrl(ctrl) {}
+
+	template <class U, class P, class ...Args>
+	friend std::enable_if_t<!std::is_array_v<U>, Shared_ptr<U, P>> Make_shared(Args&& ...args);
+
+	template <class U, class P, class A, class ...Args>
+	friend Shared_ptr<U, P> AllocateShared(const A& alloc, Args&& ...args);
+
+	template <class U>
+	friend class AtomicSharedPtr;
+
+	template <class U, class P>
+	friend class Shared_ptr;
+
+	template <class U, class P>
+	friend class EnableSharedFromThis;
+
+	template <class U, class P>
+	friend class WeakPtr;
+
+	// Lets an object that derives from EnableSharedFromThis find the
+	// block of the first Shared_ptr that took ownership of it
+	template <class U>
+	void attach_self(EnableSharedFromThis<U, Policy>* self) noexcept
+	{
+		if (self && !self->m_selfCtrl)
+			self->m_selfCtrl = m_ctrl;
+	}
+
+	void attach_self(...) noexcept {}
+public:
+	Shared_ptr() noexcept :m_ptr(nullptr), m_ctrl(nullptr) {}
+
+	Shared_ptr(std::nullptr_t) noexcept :m_ptr(nullptr), m_ctrl(nullptr) {}
+
+	// A null ptr gets no block, so it never allocates. Explicit, so a raw
+	// pointer is never adopted by accident, e.g. by sp == raw
+	explicit Shared_ptr(T* ptr) :m_ptr(ptr), m_ctrl(nullptr)
+	{
+		if (m_ptr)
+		{
+			try
+			{
+				m_ctrl = new PointerBlock<T, Policy>(m_ptr);
+			}
+			catch (...)
+			{
+				delete ptr;
+				throw;
+			}
+		}
+		attach_self(m_ptr);
+	}
+
+	// Aliasing constructor: shares owner's count but points at ptr,
+	// usually a member of owner's object. Nothing is allocated.
+	template<class U>
+	Shared_ptr(const Shared_ptr<U, Policy>& owner, T* ptr) noexcept :m_ptr(ptr), m_ctrl(owner.m_ctrl)
+	{
+		if (m_ctrl)
+			Policy::increment(m_ctrl->strong);
+	}
+
+	template<class U>
+	Shared_ptr(Shared_ptr<U, Policy>&& owner, T* ptr) noexcept :m_ptr(ptr), m_ctrl(owner.m_ctrl)
+	{
+		owner.m_ptr = nullptr;
+		owner.m_ctrl = nullptr;
+	}
+
+	// Takes ownership of ptr; deleter(ptr) runs when the last owner goes
+	template<class D, class = std::enable_if_t<std::is_invocable_v<D&, T*>>>
+	explicit Shared_ptr(T* ptr, D deleter) :m_ptr(ptr), m_ctrl(nullptr)
+	{
+		try
+		{
+			m_ctrl = new DeleterBlock<T, D, Policy>(ptr, deleter);
+		}
+		catch (...)
+		{
+			deleter(ptr);
+			throw;
+		}
+		attach_self(m_ptr);
+	}
+
+	// Empty if the object has already been destroyed
+	explicit Shared_ptr(const WeakPtr<T, Policy>& weak) noexcept :m_ptr(nullptr), m_ctrl(nullptr)
+	{
+		if (weak.m_ctrl && Policy::increment_if_nonzero(weak.m_ctrl->strong))
+		{
+			m_ptr = weak.m_ptr;
+			m_ctrl = weak.m_ctrl;
+		}
+	}
+
+	~Shared_ptr()
+	{
+		if (m_ctrl)
+			m_ctrl->release();
+	}
+
+	Shared_ptr(const Shared_ptr& a) noexcept :m_ptr(a.m_ptr), m_ctrl(a.m_ctrl)
+	{
+		if (m_ctrl)
+			Policy::increment(m_ctrl->strong);
+	}
+
+	Shared_ptr(Shared_ptr&& a) noexcept :m_ptr(a.m_ptr), m_ctrl(a.m_ctrl)
+	{
+		a.m_ptr = nullptr;
+		a.m_ctrl = nullptr;
+	}
+
+	// The new count is taken before the old one is dropped, which makes
+	// self-assignment safe, and the old object is released only after
+	// this pointer is consistent again, in case its destructor reaches
+	// back here
+	Shared_ptr& operator=(const Shared_ptr& a) noexcept
+	{
+		if (a.m_ctrl)
+			Policy::increment(a.m_ctrl->strong);
+		ControlBlock<Policy>* old = m_ctrl;
+		m_ptr = a.m_ptr;
+		m_ctrl = a.m_ctrl;
+		if (old)
+			old->release();
+		return *this;
+	}
+
+	Shared_ptr& operator=(Shared_ptr&& a) noexcept
+	{
+		if (this != &a)
+		{
+			ControlBlock<Policy>* old = m_ctrl;
+			m_ptr = a.m_ptr;
+			m_ctrl = a.m_ctrl;
+			a.m_ptr = nullptr;
+			a.m_ctrl = nullptr;
+			if (old)
+				old->release();
+		}
+		return *this;
+	}
+
+	Shared_ptr& operator=(std::nullptr_t) noexcept
+	{
+		reset();
+		return *this;
+	}
+
+	T& operator*() const noexcept { return *m_ptr; }
+	T* operator->() const noexcept { return m_ptr; }
+
+	void swap(Shared_ptr& src) noexcept
+	{
+		std::swap(m_ptr, src.m_ptr);
+		std::swap(m_ctrl, src.m_ctrl);
+	}
+
+	int unique() const noexcept
+	{
+		return use_count() == 1;
+	}
+
+	T* get() const noexcept { return m_ptr; }
+
+	void reset() noexcept
+	{
+		ControlBlock<Policy>* old = m_ctrl;
+		m_ptr = nullptr;
+		m_ctrl = nullptr;
+		if (old)
+			old->release();
+	}
+
+	void reset(T* ptr)
+	{
+		Shared_ptr(ptr).swap(*this);
+	}
+
+	explicit operator bool() const noexcept {
+		return m_ptr != nullptr;
+	}
+
+	bool operator==(std::nullptr_t) const noexcept {
+		return m_ptr == nullptr;
+	}
+
+	bool operator!=(std::nullptr_t) const noexcept {
+		return m_ptr != nullptr;
+	}
+
+	bool operator!=(const Shared_ptr& src) const noexcept {
+		return m_ptr != src.m_ptr;
+	}
+
+	bool operator==(const Shared_ptr& src) const noexcept {
+		return m_ptr == src.m_ptr;
+	}
+
+	uint32_t use_count() const noexcept
+	{
+		return m_ctrl ? Policy::load(m_ctrl->strong) : 0;
+	}
+
+	friend std::ostream& operator<<(std::ostream& os, const Shared_ptr& sp)
+	{
+		os << "Address pointed : " << sp.get() << std::endl;
+		return os;
+	}
+};
+
+// Observes an object owned by Shared_ptrs without keeping it alive. It
+// holds a weak count, so the block stays readable after the object dies
+// and lock() can tell a dead object from a live one.
+template<class T, class Policy>
+class WeakPtr
+{
+	T* m_ptr;
+	ControlBlock<Policy>* m_ctrl;
+
+	template <class U, class P>
+	friend class Shared_ptr;
+
+	void acquire() noexcept
+	{
+		if (m_ctrl)
+			Policy::increment(m_ctrl->weak);
+	}
+public:
+	WeakPtr() noexcept :m_ptr(nullptr), m_ctrl(nullptr) {}
+
+	WeakPtr(const Shared_ptr<T, Policy>& sp) noexcept :m_ptr(sp.m_ptr), m_ctrl(sp.m_ctrl)
+	{
+		acquire();
+	}
+
+	WeakPtr(const WeakPtr& a) noexcept :m_ptr(a.m_ptr), m_ctrl(a.m_ctrl)
+	{
+		acquire();
+	}
+
+	WeakPtr(WeakPtr&& a) noexcept :m_ptr(a.m_ptr), m_ctrl(a.m_ctrl)
+	{
+		a.m_ptr = nullptr;
+		a.m_ctrl = nullptr;
+	}
+
+	~WeakPtr()
+	{
+		if (m_ctrl)
+			m_ctrl->release_weak();
+	}
+
+	WeakPtr& operator=(const WeakPtr& a) noexcept
+	{
+		WeakPtr(a).swap(*this);
+		return *this;
+	}
+
+	WeakPtr& operator=(WeakPtr&& a) noexcept
+	{
+		WeakPtr(std::move(a)).swap(*this);
+		return *this;
+	}
+
+	WeakPtr& operator=(const Shared_ptr<T, Policy>& sp) noexcept
+	{
+		WeakPtr(sp).swap(*this);
+		return *this;
+	}
+
+	void swap(WeakPtr& src) noexcept
+	{
+		std::swap(m_ptr, src.m_ptr);
+		std::swap(m_ctrl, src.m_ctrl);
+	}
+
+	void reset() noexcept
+	{
+		WeakPtr().swap(*this);
+	}
+
+	Shared_ptr<T, Policy> lock() const noexcept
+	{
+		return Shared_ptr<T, Policy>(*this);
+	}
+
+	uint32_t use_count() const noexcept
+	{
+		return m_ctrl ? Policy::load(m_ctrl->strong) : 0;
+	}
+
+	bool expired() const noexcept
+	{
+		return use_count() == 0;
+	}
+
+	bool owner_before(const WeakPtr& src) const noexcept
+	{
+		return std::less<ControlBlock<Policy>*>()(m_ctrl, src.m_ctrl);
+	}
+};
+
+
+// Base for objects that need a Shared_ptr to themselves. The object
+// remembers the block of its first owner, which always outlives it, so
+// shared_from_this() only bumps the count. Throws bad_weak_ptr when no
+// Shared_ptr of the same policy owns the object.
+template<class T, class Policy>
+class EnableSharedFromThis
+{
+	ControlBlock<Policy>* m_selfCtrl = nullptr;
+
+	template <class U, class P>
+	friend class Shared_ptr;
+
+protected:
+	EnableSharedFromThis() noexcept {}
+	EnableSharedFromThis(const EnableSharedFromThis&) noexcept {}
+	EnableSharedFromThis& operator=(const EnableSharedFromThis&) noexcept { return *this; }
+	~EnableSharedFromThis() = default;
+
+public:
+	Shared_ptr<T, Policy> shared_from_this()
+	{
+		if (!m_selfCtrl || !Policy::increment_if_nonzero(m_selfCtrl->strong))
+			throw std::bad_weak_ptr();
+		return Shared_ptr<T, Policy>(static_cast<T*>(this), m_selfCtrl);
+	}
+};
+
+// Deleter behind Shared_ptr<T[]>
+struct ArrayDeleter
+{
+	template<class T>
+	void operator()(T* ptr) const noexcept { delete[] ptr; }
+};
+
+// Shared_ptr to an array allocated with new[]. Uses the same blocks and
+// the same copy, move and reset paths as the single-object version.
+template<class T, class Policy>
+class Shared_ptr<T[], Policy>
+{
+	T* m_ptr;
+	ControlBlock<Policy>* m_ctrl;
+public:
+	Shared_ptr() noexcept :m_ptr(nullptr), m_ctrl(nullptr) {}
+
+	Shared_ptr(std::nullptr_t) noexcept :m_ptr(nullptr), m_ctrl(nullptr) {}
+
+	explicit Shared_ptr(T* ptr) :m_ptr(ptr), m_ctrl(nullptr)
+	{
+		if (m_ptr)
+		{
+			try
+			{
+				m_ctrl = new DeleterBlock<T, ArrayDeleter, Policy>(ptr, ArrayDeleter());
+			}
+			catch (...)
+			{
+				delete[] ptr;
+				throw;
+			}
+		}
+	}
+
+	~Shared_ptr()
+	{
+		if (m_ctrl)
+			m_ctrl->release();
+	}
+
+	Shared_ptr(const Shared_ptr& a) noexcept :m_ptr(a.m_ptr), m_ctrl(a.m_ctrl)
+	{
+		if (m_ctrl)
+			Policy::increment(m_ctrl->strong);
+	}
+
+	Shared_ptr(Shared_ptr&& a) noexcept :m_ptr(a.m_ptr), m_ctrl(a.m_ctrl)
+	{
+		a.m_ptr = nullptr;
+		a.m_ctrl = nullptr;
+	}
+
+	Shared_ptr& operator=(const Shared_ptr& a) noexcept
+	{
+		if (a.m_ctrl)
+			Policy::increment(a.m_ctrl->strong);
+		ControlBlock<Policy>* old = m_ctrl;
+		m_ptr = a.m_ptr;
+		m_ctrl = a.m_ctrl;
+		if (old)
+			old->release();
+		return *this;
+	}
+
+	Shared_ptr& operator=(Shared_ptr&& a) noexcept
+	{
+		if (this != &a)
+		{
+			ControlBlock<Policy>* old = m_ctrl;
+			m_ptr = a.m_ptr;
+			m_ctrl = a.m_ctrl;
+			a.m_ptr = nullptr;
+			a.m_ctrl = nullptr;
+			if (old)
+				old->release();
+		}
+		return *this;
+	}
+
+	T& operator*() const noexcept { return *m_ptr; }
+	T* operator->() const noexcept { return m_ptr; }
+
+	T& operator[](size_t pos) const noexcept {
+		return m_ptr[pos];
+	}
+
+	void swap(Shared_ptr& src) noexcept
+	{
+		std::swap(m_ptr, src.m_ptr);
+		std::swap(m_ctrl, src.m_ctrl);
+	}
+
+	int unique() const noexcept
+	{
+		return use_count() == 1;
+	}
+
+	T* get() const noexcept { return m_ptr; }
+
+	void reset() noexcept
+	{
+		ControlBlock<Policy>* old = m_ctrl;
+		m_ptr = nullptr;
+		m_ctrl = nullptr;
+		if (old)
+			old->release();
+	}
+
+	void reset(T* ptr)
+	{
+		Shared_ptr(ptr).swap(*this);
+	}
+
+	explicit operator bool() const noexcept {
+		return m_ptr != nullptr;
+	}
+
+	uint32_t use_count() const noexcept
+	{
+		return m_ctrl ? Policy::load(m_ctrl->strong) : 0;
+	}
+};
+template <class T, class Policy, class ...Args>
+std::enable_if_t<!std::is_array_v<T>, Shared_ptr<T, Policy>>
+Make_shared(Args&& ...args)
+{
+	InplaceBlock<T, Policy>* block = new InplaceBlock<T, Policy>(std::forward<Args>(args)...);
+	Shared_ptr<T, Policy> result(block->get(), block);
+	result.attach_self(result.m_ptr);
+	return result;
+};
+
+template <class T, class Policy = SingleThreaded>
+std::enable_if_t<std::is_array_v<T>, Shared_ptr<T, Policy>>
+Make_shared(int size)
+{
+	using type = std::remove_extent_t<T>;
+	return Shared_ptr<T, Policy>(new type[size]);
+};
+// Like Make_shared, but the object and its counts share one block taken
+// from alloc, and the block goes back to alloc when the last weak
+// reference is gone
+template <class T, class Policy, class Alloc, class ...Args>
+Shared_ptr<T, Policy> AllocateShared(const Alloc& alloc, Args&& ...args)
+{
+	using Block = AllocatedBlock<T, Alloc, Policy>;
+	using BlockAlloc = typename std::allocator_traits<Alloc>::template rebind_alloc<Block>;
+	BlockAlloc blockAlloc(alloc);
+	Block* block = std::allocator_traits<BlockAlloc>::allocate(blockAlloc, 1);
+	try
+	{
+		new (block) Block(alloc, std::forward<Args>(args)...);
+	}
+	catch (...)
+	{
+		std::allocator_traits<BlockAlloc>::deallocate(blockAlloc, block, 1);
+		throw;
+	}
+	Shared_ptr<T, Policy> result(block->get(), block);
+	result.attach_self(result.m_ptr);
+	return result;
+}
+
+// A Shared_ptr<T, ThreadSafe> that many threads can load and replace at
+// once without a lock. The stored value lives in a Snapshot, and the word
+// holding the Snapshot's address also carries, in its top 16 bits, the
+// number of loads currently copying out of it. A load bumps that count
+// before touching the Snapshot and takes it back afterwards; if the word
+// was replaced in between, the writer has moved the count onto the
+// Snapshot itself, and whichever side brings it to zero frees it.
+template <class T>
+class AtomicSharedPtr
+{
+	using Ptr = Shared_ptr<T, ThreadSafe>;
+
+	struct Snapshot
+	{
+		Ptr value;
+		std::atomic<int> readers{ 0 };
+		explicit Snapshot(Ptr&& value) :value(std::move(value)) {}
+	};
+
+	static constexpr int countShift = 48;
+	static constexpr uint64_t oneReader = uint64_t(1) << countShift;
+	static constexpr uint64_t addressMask = oneReader - 1;
+
+	mutable std::atomic<uint64_t> m_word;
+
+	static uint64_t pack(Snapshot* snapshot)
+	{
+		return reinterpret_cast<uintptr_t>(snapshot);
+	}
+
+	static Snapshot* unpack(uint64_t word)
+	{
+		return reinterpret_cast<Snapshot*>(static_cast<uintptr_t>(word & addressMask));
+	}
+
+	static Snapshot* make_snapshot(Ptr&& value)
+	{
+		return value.m_ctrl ? new Snapshot(std::move(value)) : nullptr;
+	}
+
+	// Returns the Snapshot currently stored, registered as being read
+	Snapshot* acquire() const
+	{
+		return unpack(m_word.fetch_add(oneReader, std::memory_order_acquire));
+	}
+
+	void release(Snapshot* snapshot) const
+	{
+		uint64_t current = m_word.load(std::memory_order_relaxed);
+		while (unpack(current) == snapshot)
+		{
+			if (m_word.compare_exchange_weak(current, current - oneReader, std::memory_order_release, std::memory_order_relaxed))
+				return;
+		}
+		if (snapshot && snapshot->readers.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			delete snapshot;
+	}
+
+	// Called by whoever swapped word out of m_word: hands its outstanding
+	// reader count over to the Snapshot
+	static void retire(uint64_t word)
+	{
+		Snapshot* snapshot = unpack(word);
+		int pending = static_cast<int>(word >> countShift);
+		if (snapshot && snapshot->readers.fetch_add(pending, std::memory_order_acq_rel) == -pending)
+			delete snapshot;
+	}
+
+	static bool same(const Ptr& a, const Ptr& b)
+	{
+		return a.m_ptr == b.m_ptr && a.m_ctrl == b.m_ctrl;
+	}
+
+public:
+	AtomicSharedPtr() :m_word(0) {}
+
+	AtomicSharedPtr(Ptr value) :m_word(pack(make_snapshot(std::move(value)))) {}
+
+	AtomicSharedPtr(const AtomicSharedPtr&) = delete;
+	AtomicSharedPtr& operator=(const AtomicSharedPtr&) = delete;
+
+	~AtomicSharedPtr()
+	{
+		retire(m_word.load(std::memory_order_acquire));
+	}
+
+	bool is_lock_free() const
+	{
+		return m_word.is_lock_free();
+	}
+
+	Ptr load() const
+	{
+		Snapshot* snapshot = acquire();
+		if (!snapshot)
+		{
+			release(snapshot);
+			return Ptr();
+		}
+		Ptr result = snapshot->value;
+		release(snapshot);
+		return result;
+	}
+
+	operator Ptr() const
+	{
+		return load();
+	}
+
+	void store(Ptr desired)
+	{
+		retire(m_word.exchange(pack(make_snapshot(std::move(desired))), std::memory_order_acq_rel));
+	}
+
+	AtomicSharedPtr& operator=(Ptr desired)
+	{
+		store(std::move(desired));
+		return *this;
+	}
+
+	Ptr exchange(Ptr desired)
+	{
+		Snapshot* fresh = make_snapshot(std::move(desired));
+		uint64_t old = m_word.exchange(pack(fresh), std::memory_order_acq_rel);
+		Ptr result = unpack(old) ? unpack(old)->value : Ptr();
+		retire(old);
+		return result;
+	}
+
+	// Replaces the stored pointer with desired if it still owns and points
+	// at the same object as expected; otherwise loads it into expected
+	bool compare_exchange_strong(Ptr& expected, Ptr desired)
+	{
+		Snapshot* fresh = nullptr;
+		for (;;)
+		{
+			Snapshot* current = acquire();
+			if (!same(current ? current->value : Ptr(), expected))
+			{
+				expected = current ? current->value : Ptr();
+				release(current);
+				delete fresh;
+				return false;
+			}
+			if (!fresh)
+				fresh = make_snapshot(std::move(desired));
+			uint64_t word = m_word.load(std::memory_order_relaxed);
+			while (unpack(word) == current)
+			{
+				if (m_word.compare_exchange_weak(word, pack(fresh), std::memory_order_acq_rel, std::memory_order_relaxed))
+				{
+					retire(word);
+					release(current);
+					return true;
+				}
+			}
+			release(current);
+		}
+	}
+
+	bool compare_exchange_weak(Ptr& expected, Ptr desired)
+	{
+		return compare_exchange_strong(expected, std::move(desired));
+	}
+};
+
+// Base for objects that carry their own reference count for IntrusivePtr.
+// A copied object starts with a fresh count of its own.
+template<typename Policy = SingleThreaded>
+class RefCounted {
+public:
+	void add_ref() const noexcept {
+		Policy::increment(refs);
+	}
+
+	// True when the last reference is gone
+	bool release_ref() const noexcept {
+		return Policy::decrement(refs);
+	}
+
+	uint32_t ref_count() const noexcept {
+		return Policy::load(refs);
+	}
+
+protected:
+	RefCounted() {}
+	RefCounted(const RefCounted&) {}
+	RefCounted& operator=(const RefCounted&) { return *this; }
+	~RefCounted() = default;
+
+private:
+	mutable typename Policy::count_type refs{ 0 };
+};
+
+// Pointer to a RefCounted object. The count lives inside the object, so
+// there is no control block to allocate or to touch on every copy.
+template<typename T>
+class IntrusivePtr {
+public:
+	using element_type = T;
+
+	IntrusivePtr() : ptr_(nullptr) {}
+
+	IntrusivePtr(std::nullptr_t) : ptr_(nullptr) {}
+
+	explicit IntrusivePtr(T* p) : ptr_(p) {
+		if (ptr_) {
+			ptr_->add_ref();
+		}
+	}
+
+	IntrusivePtr(const IntrusivePtr& other) : ptr_(other.ptr_) {
+		if (ptr_) {
+			ptr_->add_ref();
+		}
+	}
+
+	IntrusivePtr(IntrusivePtr&& other) noexcept : ptr_(other.ptr_) {
+		other.ptr_ = nullptr;
+	}
+
+	IntrusivePtr& operator=(const IntrusivePtr& other) {
+		IntrusivePtr(other).swap(*this);
+		return *this;
+	}
+
+	IntrusivePtr& operator=(IntrusivePtr&& other) noexcept {
+		IntrusivePtr(std::move(other)).swap(*this);
+		return *this;
+	}
+
+	IntrusivePtr& operator=(std::nullptr_t) noexcept {
+		reset();
+		return *this;
+	}
+
+	~IntrusivePtr() {
+		if (ptr_ && ptr_->release_ref()) {
+			delete ptr_;
+		}
+	}
+
+	T* get() const noexcept {
+		return ptr_;
+	}
+
+	// Drops this reference; the object is deleted if it was the last one
+	void reset() noexcept {
+		T* old = ptr_;
+		ptr_ = nullptr;
+		if (old && old->release_ref()) {
+			delete old;
+		}
+	}
+
+	void reset(T* p) {
+		IntrusivePtr(p).swap(*this);
+	}
+
+	void swap(IntrusivePtr& other) noexcept {
+		std::swap(ptr_, other.ptr_);
+	}
+
+	explicit operator bool() const noexcept {
+		return ptr_ != nullptr;
+	}
+
+	T& operator*() const noexcept {
+		return *ptr_;
+	}
+
+	T* operator->() const {
+		return ptr_;
+	}
+
+	bool operator==(std::nullptr_t) const noexcept {
+		return ptr_ == nullptr;
+	}
+
+	bool operator==(const IntrusivePtr& ptr) const noexcept {
+		return ptr_ == ptr.ptr_;
+	}
+
+	bool operator!=(const IntrusivePtr& ptr) const noexcept {
+		return ptr_ != ptr.ptr_;
+	}
+
+	friend std::ostream& operator<<(std::ostream& os, const IntrusivePtr<T>& p) {
+		os << p.ptr_;
+		return os;
+	}
+
+private:
+	T* ptr_;
+};
+
+template<typename T, typename... Args>
+IntrusivePtr<T> MakeIntrusive(Args&&... args) {
+	return IntrusivePtr<T>(new T(std::forward<Args>(args)...));
+}
@@ -0,0 +1,161 @@
+﻿#pragma once
+#include <cstddef>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <vector>
+
+// Fixed-size slots carved from aligned blocks. A freed slot goes on the
+// releasing thread's free list. When a thread exits, its list moves to a
+// shared one, which threads refill from before carving a new block, so
+// slots freed on short-lived threads are reused. Blocks are returned only
+// at program exit.
+template <size_t Size, size_t Align>
+class SlotPool
+{
+	static constexpr int blockSize = 256;
+
+	union Slot
+	{
+		Slot* next;
+		alignas(Align) unsigned char storage[Size];
+	};
+
+	struct Blocks
+	{
+		std::mutex m;
+		std::vector<Slot*> all;
+		// Slots handed back by threads that have exited; guarded by m
+		Slot* spare = nullptr;
+		~Blocks()
+		{
+			for (Slot* b : all)
+				::operator delete(b, std::align_val_t(alignof(Slot)));
+		}
+	};
+
+	static Blocks& blocks()
+	{
+		static Blocks b;
+		return b;
+	}
+
+	// Moves the thread's free list to the shared one when the thread ends.
+	// head itself is trivially destructible, so a slot freed even later
+	// still has a list to go on.
+	struct ThreadExit
+	{
+		Slot*& head;
+		~ThreadExit()
+		{
+			if (!head)
+				return;
+			Slot* last = head;
+			while (last->next)
+				last = last->next;
+			std::lock_guard<std::mutex> lock(blocks().m);
+			last->next = blocks().spare;
+			blocks().spare = head;
+			head = nullptr;
+		}
+	};
+
+	static Slot*& freeList()
+	{
+		thread_local Slot* head = nullptr;
+		thread_local ThreadExit returner{ head };
+		return head;
+	}
+
+	// Takes up to a block's worth of spare slots, or carves a new block
+	static Slot* refill()
+	{
+		{
+			std::lock_guard<std::mutex> lock(blocks().m);
+			if (Slot* first = blocks().spare)
+			{
+				Slot* last = first;
+				for (int i = 1; i < blockSize && last->next; ++i)
+					last = last->next;
+				blocks().spare = last->next;
+				last->next = nullptr;
+				return first;
+			}
+		}
+
+		Slot* block = static_cast<Slot*>(::operator new(sizeof(Slot) * blockSize, std::align_val_t(alignof(Slot))));
+		try
+		{
+			std::lock_guard<std::mutex> lock(blocks().m);
+			blocks().all.push_back(block);
+		}
+		catch (...)
+		{
+			::operator delete(block, std::align_val_t(alignof(Slot)));
+			throw;
+		}
+		for (int i = 0; i < blockSize - 1; ++i)
+			block[i].next = &block[i + 1];
+		block[blockSize - 1].next = nullptr;
+		return block;
+	}
+
+public:
+	// Sets up the block registry now. An object with static storage
+	// duration that calls this from its constructor is destroyed before
+	// the blocks are freed, so it can still hand slots back at exit.
+	static void attach()
+	{
+		blocks();
+	}
+
+	static void* allocate()
+	{
+		Slot*& head = freeList();
+		if (!head)
+			head = refill();
+		Slot* slot = head;
+		head = slot->next;
+		return slot;
+	}
+
+	static void deallocate(void* p) noexcept
+	{
+		Slot* slot = static_cast<Slot*>(p);
+		slot->next = freeList();
+		freeList() = slot;
+	}
+};
+
+// Stateless allocator over SlotPool; single objects come from the pool,
+// arrays from the heap through std::allocator, which honours alignof(T)
+template <class T>
+struct PoolAllocator
+{
+	using value_type = T;
+
+	PoolAllocator() noexcept {}
+	template <class U>
+	PoolAllocator(const PoolAllocator<U>&) noexcept {}
+
+	T* allocate(size_t n)
+	{
+		if (n == 1)
+			return static_cast<T*>(SlotPool<sizeof(T), alignof(T)>::allocate());
+		return std::allocator<T>().allocate(n);
+	}
+
+	void deallocate(T* p, size_t n) noexcept
+	{
+		if (n == 1)
+			SlotPool<sizeof(T), alignof(T)>::deallocate(p);
+		else
+			std::allocator<T>().deallocate(p, n);
+	}
+
+	template <class U>
+	bool operator==(const PoolAllocator<U>&) const noexcept { return true; }
+	template <class U>
+	bool operator!=(const PoolAllocator<U>&) const noexcept { return false; }
+};
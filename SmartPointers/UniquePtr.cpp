@@ -4,22 +4,30 @@
 #include<cstdio>
 #include <type_traits>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <chrono>
+#include <cstdint>
+#include <algorithm>
+#include "CompressedPair.h"
+#include "SlotPool.h"
 
 template <class T, class Del = std::default_delete<T>>
 class UniquePtr {
 public:
 	// Constructors
-	UniquePtr() noexcept : ptr_(nullptr), deleter_(Del()) {}
-	UniquePtr(nullptr_t) noexcept : ptr_(nullptr), deleter_(Del()) {}
-	explicit UniquePtr(T* ptr) noexcept : ptr_(ptr), deleter_(Del()) {}
-	UniquePtr(T* ptr, const Del& deleter) noexcept : ptr_(ptr), deleter_(deleter) {}
-	UniquePtr(T* ptr, Del&& deleter) noexcept : ptr_(ptr), deleter_(std::move(deleter)) {}
-	UniquePtr(UniquePtr&& other) noexcept : ptr_(other.release()), deleter_(std::move(other.deleter_)) {}
+	UniquePtr() noexcept : pair_(nullptr, Del()) {}
+	UniquePtr(nullptr_t) noexcept : pair_(nullptr, Del()) {}
+	explicit UniquePtr(T* ptr) noexcept : pair_(ptr, Del()) {}
+	UniquePtr(T* ptr, const Del& deleter) noexcept : pair_(ptr, deleter) {}
+	UniquePtr(T* ptr, Del&& deleter) noexcept : pair_(ptr, std::move(deleter)) {}
+	UniquePtr(UniquePtr&& other) noexcept : pair_(other.release(), std::move(other.pair_.second())) {}
 
 	// Move assignment operator
 	UniquePtr& operator=(UniquePtr&& other) noexcept {
 		reset(other.release());
-		deleter_ = std::move(other.deleter_);
+		pair_.second() = std::move(other.pair_.second());
 		return *this;
 	}
 
@@ -34,66 +42,65 @@ public:
 
 	// Release ownership
 	T* release() noexcept {
-		T* ptr = ptr_;
-		ptr_ = nullptr;
+		T* ptr = pair_.first;
+		pair_.first = nullptr;
 		return ptr;
 	}
 
 	// Reset pointer and deleter
 	void reset(T* ptr = nullptr) noexcept {
-		if (ptr_ != ptr) {
-			deleter_(ptr_);
-			ptr_ = ptr;
+		if (pair_.first != ptr) {
+			pair_.second()(pair_.first);
+			pair_.first = ptr;
 		}
 	}
 
 	// Swap pointers and deleters
 	void swap(UniquePtr& other) noexcept {
-		std::swap(ptr_, other.ptr_);
-		std::swap(deleter_, other.deleter_);
+		std::swap(pair_.first, other.pair_.first);
+		std::swap(pair_.second(), other.pair_.second());
 	}
 
 	// Accessor
 	T* get() const noexcept {
-		return ptr_;
+		return pair_.first;
 	}
 
 	Del& get_deleter() {
-		return deleter_;
+		return pair_.second();
 	}
 
 	const Del& get_deleter() const {
-		return deleter_;
+		return pair_.second();
 	}
 
 	// Dereference operator
 	T& operator*() const noexcept {
-		return *ptr_;
+		return *pair_.first;
 	}
 
 	T* operator->() const noexcept {
-		return ptr_;
+		return pair_.first;
 	}
 	bool operator!=(std::nullptr_t) const {
-		return ptr_ == nullptr;
+		return pair_.first == nullptr;
 	}
 
 	bool operator==(std::nullptr_t) const {
-		return ptr_ == nullptr;
+		return pair_.first == nullptr;
 	}
-	friend std::ostream& operator<<(std::ostream& os, const UniquePtr<T>& p) {
-		os << p.ptr_;
+	friend std::ostream& operator<<(std::ostream& os, const UniquePtr& p) {
+		os << p.pair_.first;
 		return os;
 	}
 
 	// Boolean conversion operator
 	explicit operator bool() const noexcept {
-		return ptr_ != nullptr;
+		return pair_.first != nullptr;
 	}
 
 private:
-	T* ptr_;
-	Del deleter_;
+	CompressedPair<Del, T*> pair_;
 };
 
 template <class T, class D>
@@ -104,25 +111,25 @@ public:
 	using deleter_type = D;
 
 	// Constructors
-	constexpr UniquePtr() noexcept : ptr_(nullptr), deleter_(deleter_type()) {}
+	constexpr UniquePtr() noexcept : pair_(nullptr, deleter_type()) {}
 
 	template <class U>
-	explicit UniquePtr(U p) noexcept : ptr_(p), deleter_(deleter_type()) {}
+	explicit UniquePtr(U p) noexcept : pair_(p, deleter_type()) {}
 
 	template <class U>
 	UniquePtr(U p, typename std::enable_if<std::is_convertible<U, pointer>::value, deleter_type>::type d) noexcept
-		: ptr_(p), deleter_(d) {}
+		: pair_(p, d) {}
 
 	template <class U>
 	UniquePtr(U p, typename std::enable_if<std::is_convertible<U, pointer>::value, deleter_type&&>::type d) noexcept
-		: ptr_(p), deleter_(std::move(d)) {}
+		: pair_(p, std::move(d)) {}
 
-	UniquePtr(UniquePtr&& u) noexcept : ptr_(u.ptr_), deleter_(std::move(u.deleter_)) {
-		u.ptr_ = nullptr;
+	UniquePtr(UniquePtr&& u) noexcept : pair_(u.pair_.first, std::move(u.pair_.second())) {
+		u.pair_.first = nullptr;
 	}
 
 	template <class U, class E>
-	UniquePtr(UniquePtr<U, E>&& u) noexcept : ptr_(u.release()), deleter_(std::move(u.get_deleter())) {}
+	UniquePtr(UniquePtr<U, E>&& u) noexcept : pair_(u.release(), std::move(u.get_deleter())) {}
 
 	// Destructor
 	~UniquePtr() {
@@ -132,14 +139,14 @@ public:
 	// Move assignment operators
 	UniquePtr& operator=(UniquePtr&& u) noexcept {
 		reset(u.release());
-		deleter_ = std::move(u.deleter_);
+		pair_.second() = std::move(u.pair_.second());
 		return *this;
 	}
 
 	template <class U, class E>
 	UniquePtr& operator=(UniquePtr<U, E>&& u) noexcept {
 		reset(u.release());
-		deleter_ = std::move(u.get_deleter());
+		pair_.second() = std::move(u.get_deleter());
 		return *this;
 	}
 
@@ -150,38 +157,38 @@ public:
 
 	// Element access
 	T& operator[](size_t i) const {
-		return ptr_[i];
+		return pair_.first[i];
 	}
 
 	// Accessors
 	pointer get() const noexcept {
-		return ptr_;
+		return pair_.first;
 	}
 
 	deleter_type& get_deleter() noexcept {
-		return deleter_;
+		return pair_.second();
 	}
 
 	const deleter_type& get_deleter() const noexcept {
-		return deleter_;
+		return pair_.second();
 	}
 
 	explicit operator bool() const noexcept {
-		return ptr_ != nullptr;
+		return pair_.first != nullptr;
 	}
 
 	// Release ownership
 	pointer release() noexcept {
-		pointer p = ptr_;
-		ptr_ = nullptr;
+		pointer p = pair_.first;
+		pair_.first = nullptr;
 		return p;
 	}
 
 	// Reset pointer and deleter
 	void reset(pointer p = pointer()) noexcept {
-		if (ptr_ != p) {
-			deleter_(ptr_);
-			ptr_ = p;
+		if (pair_.first != p) {
+			pair_.second()(pair_.first);
+			pair_.first = p;
 		}
 	}
 
@@ -190,11 +197,11 @@ public:
 	}
 
 	bool operator!=(std::nullptr_t) const {
-		return ptr_ == nullptr;
+		return pair_.first == nullptr;
 	}
 
 	bool operator==(std::nullptr_t) const {
-		return ptr_ == nullptr;
+		return pair_.first == nullptr;
 	}
 
 	template <class U>
@@ -202,15 +209,17 @@ public:
 
 	// Swap pointers and deleters
 	void swap(UniquePtr& u) noexcept {
-		std::swap(ptr_, u.ptr_);
-		std::swap(deleter_, u.deleter_);
+		std::swap(pair_.first, u.pair_.first);
+		std::swap(pair_.second(), u.pair_.second());
 	}
 
 private:
-	pointer ptr_;
-	deleter_type deleter_;
+	CompressedPair<deleter_type, pointer> pair_;
 };
 
+static_assert(sizeof(UniquePtr<int>) == sizeof(int*), "a stateless deleter must cost no space");
+static_assert(sizeof(UniquePtr<int[]>) == sizeof(int*), "a stateless deleter must cost no space");
+
 // Non-member swap function
 template <class T, class Del>
 void Swap(UniquePtr<T, Del>& lhs, UniquePtr<T, Del>& rhs) noexcept {
@@ -228,8 +237,190 @@ UniquePtr<T> MakeUnique(Args&&... args) {
 	return UniquePtr<T>(new T(std::forward<Args>(args)...));
 }
 
+// Deleter that destroys the object and hands its memory back to the
+// allocator it came from. A stateless allocator is kept in an empty base,
+// so it adds nothing to the deleter's size.
+template <class Alloc>
+struct AllocatorDeleter : private EboStorage<Alloc> {
+	using traits = std::allocator_traits<Alloc>;
+	using value_type = typename traits::value_type;
+
+	AllocatorDeleter() = default;
+	explicit AllocatorDeleter(const Alloc& alloc) : EboStorage<Alloc>(alloc) {}
+
+	void operator()(value_type* p) noexcept {
+		if (!p)
+			return;
+		Alloc& alloc = EboStorage<Alloc>::get();
+		traits::destroy(alloc, p);
+		traits::deallocate(alloc, p, 1);
+	}
+};
+
+static_assert(std::is_empty<AllocatorDeleter<PoolAllocator<int>>>::value,
+	"a stateless allocator must give an empty deleter");
+
+// Like MakeUnique, but the object lives in memory from alloc and is
+// returned to it on destruction
+template <class T, class Alloc, class... Args>
+UniquePtr<T, AllocatorDeleter<typename std::allocator_traits<Alloc>::template rebind_alloc<T>>>
+AllocateUnique(const Alloc& alloc, Args&&... args) {
+	using Rebound = typename std::allocator_traits<Alloc>::template rebind_alloc<T>;
+	using traits = std::allocator_traits<Rebound>;
+	Rebound a(alloc);
+	T* p = traits::allocate(a, 1);
+	try {
+		traits::construct(a, p, std::forward<Args>(args)...);
+	}
+	catch (...) {
+		traits::deallocate(a, p, 1);
+		throw;
+	}
+	return UniquePtr<T, AllocatorDeleter<Rebound>>(p, AllocatorDeleter<Rebound>(a));
+}
+
+template <class F>
+double measure_ms(F&& fn) {
+	auto start = std::chrono::steady_clock::now();
+	fn();
+	auto stop = std::chrono::steady_clock::now();
+	return std::chrono::duration<double, std::milli>(stop - start).count();
+}
+
+struct Message {
+	int id;
+	double body[7];
+	explicit Message(int id) : id(id), body{} {}
+};
+
+// Keep a window of live objects and keep replacing random ones
+template <class Ptr, class Create>
+void bench_churn(const char* name, Create create) {
+	const int window = 4096;
+	const int iterations = 4000000;
+	std::vector<Ptr> live;
+	for (int i = 0; i < window; ++i)
+		live.push_back(create(i));
+
+	uint32_t seed = 1;
+	long long sum = 0;
+	double ms = measure_ms([&] {
+		for (int i = 0; i < iterations; ++i) {
+			seed = seed * 1664525u + 1013904223u;
+			Ptr& slot = live[(seed >> 8) % window];
+			sum += slot->id;
+			slot = create(i);
+		}
+	});
+	std::cout << name << ": " << sizeof(Ptr) << " bytes, "
+		<< ms * 1e6 / iterations << " ns per replace (" << sum << ")\n";
+}
+
+void bench_allocate() {
+	bench_churn<UniquePtr<Message>>("MakeUnique",
+		[](int i) { return MakeUnique<Message>(i); });
+	bench_churn<std::unique_ptr<Message>>("std::make_unique",
+		[](int i) { return std::make_unique<Message>(i); });
+	using Pooled = decltype(AllocateUnique<Message>(PoolAllocator<Message>(), 0));
+	bench_churn<Pooled>("AllocateUnique(PoolAllocator)",
+		[](int i) { return AllocateUnique<Message>(PoolAllocator<Message>(), i); });
+}
+
+// Fill, scan, sort and destroy a vector of owning pointers; the pointer
+// array itself is what a block map or node table keeps hot
+template <class Ptr, class Create>
+void bench_container(const char* name, Create create) {
+	const int n = 1000000;
+	std::vector<Ptr> items;
+	long long sum = 0;
+
+	double fill_ms = measure_ms([&] {
+		uint32_t seed = 3;
+		for (int i = 0; i < n; ++i) {
+			seed = seed * 1664525u + 1013904223u;
+			items.push_back(create(int(seed >> 8)));
+		}
+	});
+	double sort_ms = measure_ms([&] {
+		std::sort(items.begin(), items.end(), [](const Ptr& a, const Ptr& b) { return a->id < b->id; });
+	});
+	double scan_ms = measure_ms([&] {
+		for (int r = 0; r < 10; ++r)
+			for (const Ptr& p : items)
+				sum += p ? 1 : 0;
+	});
+	double destroy_ms = measure_ms([&] { items = std::vector<Ptr>(); });
+
+	std::cout << name << ": " << sizeof(Ptr) * n / 1024 << " KiB of pointers, fill " << fill_ms
+		<< " ms, sort " << sort_ms << " ms, 10 null scans " << scan_ms << " ms, destroy "
+		<< destroy_ms << " ms (" << sum << ")\n";
+}
+
+void bench_containers() {
+	bench_container<UniquePtr<Message>>("vector<UniquePtr>",
+		[](int i) { return MakeUnique<Message>(i); });
+	bench_container<std::unique_ptr<Message>>("vector<std::unique_ptr>",
+		[](int i) { return std::make_unique<Message>(i); });
+}
+
+// Deleters and allocators that cannot be empty bases, a function pointer
+// and final classes, are kept as members instead
+int deletedCount = 0;
+
+void delete_message(Message* p) {
+	++deletedCount;
+	delete p;
+}
+
+struct FinalDelete final {
+	void operator()(Message* p) const {
+		++deletedCount;
+		delete p;
+	}
+};
+
+template <class T>
+struct FinalAllocator final {
+	using value_type = T;
+
+	FinalAllocator() noexcept {}
+	template <class U>
+	FinalAllocator(const FinalAllocator<U>&) noexcept {}
+
+	T* allocate(size_t n) { return static_cast<T*>(::operator new(n * sizeof(T))); }
+	void deallocate(T* p, size_t) noexcept { ::operator delete(p); }
+
+	template <class U>
+	bool operator==(const FinalAllocator<U>&) const noexcept { return true; }
+	template <class U>
+	bool operator!=(const FinalAllocator<U>&) const noexcept { return false; }
+};
+
+static_assert(sizeof(UniquePtr<Message, void(*)(Message*)>) == 2 * sizeof(Message*),
+	"a function pointer deleter is stored next to the pointer");
+
+void check_deleters() {
+	deletedCount = 0;
+	{
+		UniquePtr<Message, void(*)(Message*)> byFunction(new Message(1), &delete_message);
+		UniquePtr<Message, FinalDelete> byFinal(new Message(2), FinalDelete());
+		UniquePtr<Message, FinalDelete> moved(std::move(byFinal));
+		auto allocated = AllocateUnique<Message>(FinalAllocator<Message>(), 3);
+		if (allocated->id != 3) {
+			std::cout << "check_deleters failed\n";
+			abort();
+		}
+	}
+	if (deletedCount != 2) {
+		std::cout << "check_deleters failed\n";
+		abort();
+	}
+	std::cout << "function pointer and final deleters: ok\n";
+}
+
 int main()
 {
+	check_deleters();
 	UniquePtr<int> a = { MakeUnique<int>(124) };
 	int* pointer = a.get();
 	std::cout << *pointer<<std::endl;
@@ -242,7 +433,7 @@ int main()
 		b[i] = i + 10;
 		std::cout << b[i] << '\n';
 	}
-	
 
-
-}
+	bench_allocate();
+	bench_containers();
+}
\ No newline at end of file
@@ -1,225 +1,119 @@
 ﻿
 #include <iostream>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <chrono>
+#include "SharedPtr.h"
+
+template <class F>
+double measure_ms(F&& fn) {
+	auto start = std::chrono::steady_clock::now();
+	fn();
+	auto stop = std::chrono::steady_clock::now();
+	return std::chrono::duration<double, std::milli>(stop - start).count();
+}
 
-template<typename T>
-class WeakPtr;
-
-template<typename T>
-class SharedPtr {
-public:
-	using element_type = T;
-
-	SharedPtr() : ptr_(nullptr), ref_count(nullptr) {}
-
-	explicit SharedPtr(T* p) : ptr_(p), ref_count(new int(1)) {}
+struct Observed {
+	static constexpr int aliveMark = 0x5eed;
+	int mark = aliveMark;
+	~Observed() { mark = 0; }
+};
 
-	SharedPtr(const SharedPtr<T>& other) : ptr_(other.ptr_), ref_count(other.ref_count) {
-		if (ref_count) {
-			++(*ref_count);
+// Observers keep locking while the owner drops the last strong reference;
+// a lock that succeeds must always see a live object
+void stress_lock() {
+	const int rounds = 200;
+	const int observers = 4;
+	std::atomic<long> locked{ 0 }, dead{ 0 };
+
+	for (int round = 0; round < rounds; ++round) {
+		Shared_ptr<Observed, ThreadSafe> owner = Make_shared<Observed, ThreadSafe>();
+		WeakPtr<Observed, ThreadSafe> weak(owner);
+		std::atomic<bool> start{ false };
+
+		std::vector<std::thread> threads;
+		for (int t = 0; t < observers; ++t) {
+			threads.emplace_back([&, weak] {
+				while (!start.load()) {
+					std::this_thread::yield();
+				}
+				for (;;) {
+					Shared_ptr<Observed, ThreadSafe> p = weak.lock();
+					if (!p) {
+						break;
+					}
+					if (p->mark != Observed::aliveMark) {
+						dead.fetch_add(1);
+					}
+					locked.fetch_add(1, std::memory_order_relaxed);
+					p.reset();
+					std::this_thread::yield();
+				}
+				if (!weak.expired()) {
+					dead.fetch_add(1);
+				}
+			});
 		}
-	}
-
-	SharedPtr(SharedPtr<T>&& other) : ptr_(nullptr), ref_count(nullptr) {
-		swap(other);
-	}
-
-	SharedPtr& operator=(const SharedPtr& sp) noexcept {
-		if (ptr_ != sp.ptr_) {
-			release();
-			ptr_ = sp.ptr_;
-			ref_count = sp.ref_count;
-			if (ref_count) {
-				++(*ref_count);
-			}
+		long target = locked.load() + 1000;
+		start.store(true);
+		while (locked.load() < target) {
+			std::this_thread::yield();
 		}
-		return *this;
-	}
-
-	SharedPtr& operator=(SharedPtr&& sp) noexcept {
-		if (ptr_ != sp.ptr_) {
-			release();
-			std::swap(ptr_, sp.ptr_);
-			std::swap(ref_count, sp.ref_count);
+		owner.reset();
+		for (std::thread& t : threads) {
+			t.join();
 		}
-		return *this;
-	}
-
-	template <class Other>
-	SharedPtr& operator=(const SharedPtr<Other>& sp) noexcept {
-		release();
-		ptr_ = sp.ptr_;
-		ref_count = sp.ref_count;
-		if (ref_count) {
-			++(*ref_count);
+		if (!weak.expired() || weak.lock()) {
+			dead.fetch_add(1);
 		}
-		return *this;
-	}
-
-	template <class Other>
-	SharedPtr& operator=(SharedPtr<Other>&& sp) noexcept {
-		release();
-		std::swap(ptr_, sp.ptr_);
-		std::swap(ref_count, sp.ref_count);
-		return *this;
-	}
-
-	~SharedPtr() {
-		release();
-	}
-
-	T* get() const noexcept {
-		return ptr_;
-	}
-
-	bool owner_before(const SharedPtr<T>& other) const {
-		return std::less<T*>()(ptr_, other.ptr_);
-	}
-
-	void reset(T* p = nullptr) {
-		release();
-		ptr_ = p;
-		ref_count = new int(1);
-	}
-
-	void swap(SharedPtr<T>& other) {
-		std::swap(ptr_, other.ptr_);
-		std::swap(ref_count, other.ref_count);
-	}
-
-	bool unique() const {
-		return use_count() == 1;
-	}
-
-	long use_count() const {
-		return ref_count ? *ref_count : 0;
-	}
-
-	explicit operator bool() const noexcept {
-		return ptr_ != nullptr;
-	}
-
-	T& operator*() const noexcept {
-		return *ptr_;
-	}
-
-	T* operator->() const {
-		return ptr_;
-	}
-
-	bool operator==(std::nullptr_t) const noexcept {
-		return ptr_ == nullptr;
-	}
-
-	friend std::ostream& operator<<(std::ostream& os, const SharedPtr<T>& p) {
-		os << p.ptr_;
-		return os;
 	}
+	std::cout << "lock stress: " << locked.load() << " successful locks, "
+		<< dead.load() << " saw a dead object\n";
+}
 
-	void release() {
-		if (ref_count) {
-			--(*ref_count);
-			if (*ref_count == 0) {
-				delete ptr_;
-				delete ref_count;
-			}
-			ptr_ = nullptr;
-			ref_count = nullptr;
+template <class Weak>
+void bench_lock(const char* name, const Weak& weak, int threads) {
+	const int iterations = 2000000;
+	std::vector<long> hits(threads);
+	double ms = measure_ms([&] {
+		std::vector<std::thread> workers;
+		for (int t = 0; t < threads; ++t) {
+			workers.emplace_back([&, t] {
+				long count = 0;
+				for (int i = 0; i < iterations; ++i) {
+					if (auto p = weak.lock()) {
+						count += p->mark != 0;
+					}
+				}
+				hits[t] = count;
+			});
 		}
-	}
-
-	template<typename U>
-	explicit SharedPtr(const WeakPtr<U>& wp) : ptr_(wp.lock().get()), ref_count(wp.ref_count) {
-		if (ref_count) {
-			++(*ref_count);
+		for (std::thread& worker : workers) {
+			worker.join();
 		}
-	}
-
-	friend class WeakPtr<T>;
-
-private:
-	T* ptr_;
-	int* ref_count;
-};
-
-template<typename T, typename... Args>
-SharedPtr<T> MakeShared(Args&&... args) {
-	return SharedPtr<T>(new T(std::forward<Args>(args)...));
+	});
+	std::cout << name << ", " << threads << " threads: "
+		<< ms * 1e6 / (double(iterations) * threads) << " ns/lock\n";
 }
 
+void bench_locks() {
+	Shared_ptr<Observed> plain = Make_shared<Observed>();
+	bench_lock("WeakPtr<SingleThreaded>", WeakPtr<Observed>(plain), 1);
 
-template<typename T>
-class WeakPtr {
-public:
-	WeakPtr() noexcept : ptr_(nullptr), ref_count(nullptr) {}
-
-	explicit WeakPtr(const SharedPtr<T>& sp) noexcept : ptr_(sp.get()), ref_count(sp.ref_count) {}
-
-	WeakPtr(const WeakPtr<T>& other) noexcept : ptr_(other.ptr_), ref_count(other.ref_count) {}
-
-	WeakPtr(WeakPtr<T>&& other) noexcept : ptr_(nullptr), ref_count(nullptr) {
-		swap(other);
-	}
-
-	WeakPtr& operator=(const SharedPtr<T>& sp) noexcept {
-		ptr_ = sp.get();
-		ref_count = sp.ref_count;
-		return *this;
-	}
-
-	WeakPtr& operator=(const WeakPtr<T>& other) noexcept {
-		ptr_ = other.ptr_;
-		ref_count = other.ref_count;
-		return *this;
-	}
-
-	WeakPtr& operator=(WeakPtr<T>&& other) noexcept {
-		swap(other);
-		return *this;
-	}
-
-	~WeakPtr() {}
-
-		SharedPtr<T> lock() const noexcept {
-		return SharedPtr<T>(*this);
+	Shared_ptr<Observed, ThreadSafe> atomic = Make_shared<Observed, ThreadSafe>();
+	WeakPtr<Observed, ThreadSafe> weak(atomic);
+	std::shared_ptr<Observed> standard = std::make_shared<Observed>();
+	std::weak_ptr<Observed> standardWeak = standard;
+	for (int threads : { 1, 2, 4 }) {
+		bench_lock("WeakPtr<ThreadSafe>", weak, threads);
+		bench_lock("std::weak_ptr", standardWeak, threads);
 	}
+}
 
-	void reset() noexcept {
-		ptr_ = nullptr;
-		ref_count = nullptr;
-	}
-
-	void swap(WeakPtr<T>& other) noexcept {
-		std::swap(ptr_, other.ptr_);
-		std::swap(ref_count, other.ref_count);
-	}
-
-	long use_count() const {
-		return ref_count ? *ref_count : 0;
-	}
-
-	bool expired() const noexcept {
-		return use_count() == 0;
-	}
-
-	bool owner_before(const WeakPtr<T>& other) const {
-		return std::less<T*>()(ptr_, other.ptr_);
-	}
-
-	explicit operator bool() const noexcept {
-		return ptr_ != nullptr;
-	}
-
-	T* get_ptr() {
-		return ptr_;
-	}
-
-	friend class SharedPtr<T>;
-
-private:
-	T* ptr_;
-	int* ref_count;
-};
 int main()
 {
-
-}
\ No newline at end of file
+	stress_lock();
+	bench_locks();
+}